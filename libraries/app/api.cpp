@@ -19,6 +19,7 @@
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/exceptions.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
@@ -26,6 +27,15 @@
 
 namespace graphene { namespace app {
 
+    /** so that a block this node no longer has is not reported as one which does not exist */
+    static void check_not_pruned( const graphene::chain::database& db, uint32_t block_num )
+    {
+       GRAPHENE_ASSERT( block_num == 0 || block_num >= db.earliest_available_block_num(),
+                        graphene::chain::block_pruned_exception,
+                        "Block ${block_num} has been pruned from this node's block log; its blocks start at ${first}",
+                        ("block_num", block_num)("first", db.earliest_available_block_num()) );
+    }
+
     database_api::database_api(graphene::chain::database& db):_db(db)
     {
        _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids) {
@@ -51,18 +61,28 @@ namespace graphene { namespace app {
 
     optional<block_header> database_api::get_block_header(uint32_t block_num) const
     {
-       auto result = _db.fetch_block_by_number(block_num);
+       check_not_pruned(_db, block_num);
+       auto result = _db.fetch_block_header_by_number(block_num);
        if(result)
-          return *result;
+          return block_header(*result);
        return {};
     }
 
+    vector<indexed_block_header> database_api::get_block_headers(uint32_t first_block_num, uint32_t limit)const
+    {
+       FC_ASSERT( limit <= 1000 );
+       check_not_pruned(_db, first_block_num);
+       return _db.fetch_block_headers(first_block_num, limit);
+    }
+
     optional<signed_block> database_api::get_block(uint32_t block_num)const
     {
+       check_not_pruned(_db, block_num);
        return _db.fetch_block_by_number(block_num);
     }
     processed_transaction database_api::get_transaction(uint32_t block_num, uint32_t trx_num)const
     {
+       check_not_pruned(_db, block_num);
        auto opt_block = _db.fetch_block_by_number(block_num);
        FC_ASSERT( opt_block );
        FC_ASSERT( opt_block->transactions.size() > trx_num );
@@ -722,40 +742,18 @@ namespace graphene { namespace app {
        const auto& idx = _db.get_index_type<account_index>();
        const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
        const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
-       auto itr = refs.account_to_account_memberships.find(account_id);
-       vector<account_id_type> result;
-
-       if( itr != refs.account_to_account_memberships.end() )
-       {
-          result.reserve( itr->second.size() );
-          for( auto item : itr->second ) result.push_back(item);
-       }
-       return result;
+       // waits for the index if it is still being built after startup
+       return refs.get_account_references( account_id );
     }
     /**
      *  @return all accounts that referr to the key or account id in their owner or active authorities.
      */
     vector<vector<account_id_type>> database_api::get_key_references( vector<public_key_type> keys )const
     {
-       vector< vector<account_id_type> > final_result;
-       final_result.reserve(keys.size());
-
-       for( auto& key : keys )
-       {
-          const auto& idx = _db.get_index_type<account_index>();
-          const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
-          const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
-          auto itr = refs.account_to_key_memberships.find(key);
-          vector<account_id_type> result;
-
-          if( itr != refs.account_to_key_memberships.end() )
-          {
-             result.reserve( itr->second.size() );
-             for( auto item : itr->second ) result.push_back(item);
-          }
-          final_result.emplace_back( std::move(result) );
-       }
-       return final_result;
+       const auto& idx = _db.get_index_type<account_index>();
+       const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+       const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
+       return refs.get_key_references( keys );
     }
 
     /** TODO: add secondary index that will accelerate this process */
@@ -25,6 +25,7 @@
 #include <graphene/time/time.hpp>
 
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/smart_ref_impl.hpp>
 
@@ -219,11 +220,11 @@ namespace detail {
 
          auto initial_state = [&] {
             ilog("Initializing database...");
+            // a genesis file is streamed rather than parsed as a whole, as it may hold millions of accounts
             if( _options->count("genesis-json") )
-               return fc::json::from_file(_options->at("genesis-json").as<boost::filesystem::path>())
-                     .as<genesis_state_type>();
+               return genesis_reader( fc::path( _options->at("genesis-json").as<boost::filesystem::path>() ) );
             else
-               return create_example_genesis();
+               return genesis_reader( create_example_genesis() );
          };
 
          if( _options->count("resync-blockchain") )
@@ -242,6 +243,16 @@ namespace detail {
             _chain_db->add_checkpoints( loaded_checkpoints );
          }
 
+         if( _options->count("prevalidation-threads") )
+            _chain_db->set_prevalidation_thread_count( _options->at("prevalidation-threads").as<uint32_t>() );
+         _chain_db->set_compress_block_log( _options->count("compress-block-log") > 0 );
+         if( _options->count("block-log-retain") )
+            _chain_db->set_block_log_retain( _options->at("block-log-retain").as<uint32_t>() );
+         if( _options->count("replay-threads") )
+            _chain_db->set_replay_thread_count( _options->at("replay-threads").as<uint32_t>() );
+         _chain_db->set_replay_verify_signatures( _options->count("replay-verify-signatures") > 0 );
+         if( _options->count("state-checkpoint-interval") )
+            _chain_db->set_state_checkpoint_interval( _options->at("state-checkpoint-interval").as<uint32_t>() );
 
          if( _options->count("replay-blockchain") )
          {
@@ -250,8 +261,8 @@ namespace detail {
          } else if( clean )
             _chain_db->open(_data_dir / "blockchain", initial_state);
          else {
-            wlog("Detected unclean shutdown. Replaying blockchain...");
-            _chain_db->reindex(_data_dir / "blockchain", initial_state());
+            wlog("Detected unclean shutdown. Replaying blockchain from the last state checkpoint...");
+            _chain_db->reindex_from_checkpoint(_data_dir / "blockchain", initial_state());
          }
 
          if( _options->count("apiaccess") )
@@ -379,7 +390,6 @@ namespace detail {
          if( _chain_db->head_block_num() == 0 )
             return result;
 
-         result.reserve(limit);
          block_id_type last_known_block_id;
          auto itr = blockchain_synopsis.rbegin();
          while( itr != blockchain_synopsis.rend() )
@@ -392,11 +402,16 @@ namespace detail {
             ++itr;
          }
 
-         for( auto num = block_header::num_from_id(last_known_block_id);
-              num <= _chain_db->head_block_num() && result.size() < limit;
-              ++num )
-            if( num > 0 )
-               result.push_back(_chain_db->get_block_id_for_num(num));
+         uint32_t first_num = std::max<uint32_t>( block_header::num_from_id(last_known_block_id), 1 );
+         if( first_num < _chain_db->earliest_available_block_num() )
+         {
+            // the peer is behind the blocks we still have; it has to sync from a node with the full history
+            ilog( "Peer needs blocks from ${first_num}, which have been pruned", ("first_num", first_num) );
+            return result;
+         }
+         result = _chain_db->get_block_ids_for_nums( first_num, limit );
+         if( result.empty() )
+            return result;
 
          if( block_header::num_from_id(result.back()) < _chain_db->head_block_num() )
             remaining_item_count = _chain_db->head_block_num() - block_header::num_from_id(result.back());
@@ -413,6 +428,9 @@ namespace detail {
          if( id.item_type == graphene::net::block_message_type )
          {
             auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
+            GRAPHENE_ASSERT( opt_block || block_header::num_from_id(id.item_hash) >= _chain_db->earliest_available_block_num(),
+                             graphene::chain::block_pruned_exception,
+                             "Block ${id} has been pruned from our block log", ("id", id.item_hash) );
             if( !opt_block )
                elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
                     ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
@@ -452,7 +470,9 @@ namespace detail {
          uint32_t head_block_num = _chain_db->head_block_num();
          result.push_back(_chain_db->head_block_id());
          uint32_t current = 1;
-         while( current < head_block_num )
+         // pruned blocks are irreversible, so a peer on another fork has diverged after them anyway
+         uint32_t earliest_block_num = _chain_db->earliest_available_block_num();
+         while( current < head_block_num && head_block_num - current >= earliest_block_num )
          {
             result.push_back(_chain_db->get_block_id_for_num(head_block_num - current));
             current = current*2;
@@ -509,6 +529,11 @@ namespace detail {
          return _chain_db->head_block_id();
       }
 
+      virtual uint32_t get_earliest_available_block_number() const override
+      {
+         return _chain_db->earliest_available_block_num();
+      }
+
       virtual uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const override
       {
          return 0; // there are no forks in graphene
@@ -567,6 +592,15 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("server-pem-password,P", bpo::value<string>()->implicit_value(""), "Password for this certificate")
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
+         ("prevalidation-threads", bpo::value<uint32_t>(), "Number of threads used to validate block transactions ahead of evaluation and to tally votes at maintenance")
+         ("compress-block-log", "Store blocks compressed when creating a new block log; an existing block log keeps its format")
+         ("block-log-retain", bpo::value<uint32_t>(), "Keep only this many of the most recent irreversible blocks in the block log, "
+          "pruning older ones; such a node cannot replay the chain or serve old blocks to peers (0 keeps every block)")
+         ("replay-threads", bpo::value<uint32_t>(), "Number of threads reading and decoding blocks ahead of a replay (0 reads them as they are applied)")
+         ("replay-verify-signatures", "Check the witness signature of every block during a replay, recovering the keys on the replay threads")
+         ("state-checkpoint-interval", bpo::value<uint32_t>()->default_value(0), "Save the state every this many blocks, so that "
+          "after a crash only the blocks since are replayed (0 writes no checkpoints). The state is written on the thread "
+          "applying blocks, which stalls the node for as long as writing it takes")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
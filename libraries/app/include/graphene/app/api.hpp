@@ -63,12 +63,23 @@ namespace graphene { namespace app {
           * @brief Retrieve a block header
           * @param block_num Height of the block whose header should be returned
           * @return header of the referenced block, or null if no matching block was found
+          *
+          * Throws block_pruned_exception if the block has been pruned from this node's block log.
           */
          optional<block_header> get_block_header(uint32_t block_num)const;
+         /**
+          * @brief Retrieve the signed headers of consecutive blocks, without their transactions
+          * @param first_block_num Height of the first block whose header should be returned
+          * @param limit Maximum number of headers to return; at most 1000
+          * @return the headers of first_block_num and the blocks after it, ending early at the head block
+          */
+         vector<indexed_block_header> get_block_headers(uint32_t first_block_num, uint32_t limit)const;
          /**
           * @brief Retrieve a full, signed block
           * @param block_num Height of the block to be returned
           * @return the referenced block, or null if no matching block was found
+          *
+          * Throws block_pruned_exception if the block has been pruned from this node's block log.
           */
          optional<signed_block> get_block(uint32_t block_num)const;
 
@@ -471,6 +482,7 @@ FC_REFLECT( graphene::app::network_broadcast_api::transaction_confirmation,
 FC_API(graphene::app::database_api,
        (get_objects)
        (get_block_header)
+       (get_block_headers)
        (get_block)
        (get_transaction)
        (get_global_properties)
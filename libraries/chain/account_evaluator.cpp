@@ -62,7 +62,8 @@ void_result account_create_evaluator::do_evaluate( const account_create_operatio
 
 object_id_type account_create_evaluator::do_apply( const account_create_operation& o )
 { try {
-   const auto& stats_obj = db().create<account_statistics_object>( [&]( account_statistics_object& ){
+   const auto& stats_obj = db().create<account_statistics_object>( [&]( account_statistics_object& s ){
+      s.owner = db().get_index_type<account_index>().get_next_id();
    });
 
    const auto& new_acnt_object = db().create<account_object>( [&]( account_object& obj ){
@@ -19,6 +19,10 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/database.hpp>
 #include <fc/uint128.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <tuple>
 
 namespace graphene { namespace chain {
 
@@ -141,6 +145,129 @@ set<public_key_type> account_member_index::get_key_members(const account_object&
    return result;
 }
 
+/**
+ *  The members of the accounts loaded from disk, read while loading and sorted into maps on a background thread.
+ *  Until the maps are handed over, changes to the index are queued here, and applied in order afterwards.
+ */
+struct account_member_index::build_state
+{
+   ~build_state()
+   {
+      try {
+         if( done.valid() )
+            done.wait();
+      } catch( ... ) {
+      }
+   }
+
+   vector< pair<account_id_type, account_id_type> >          account_entries;
+   vector< pair<public_key_type, account_id_type> >          key_entries;
+   member_map<account_id_type>                               account_memberships;
+   member_map<public_key_type>                               key_memberships;
+
+   vector< std::tuple<account_id_type, account_id_type, bool> > account_changes;
+   vector< std::tuple<public_key_type, account_id_type, bool> > key_changes;
+
+   std::unique_ptr<fc::thread>                               thread;
+   fc::future<void>                                          done;
+};
+
+account_member_index::account_member_index() {}
+account_member_index::~account_member_index() {}
+
+template<typename Key>
+static void insert_sorted( account_member_index::member_map<Key>& memberships, vector< pair<Key, account_id_type> >& entries )
+{
+   // sorted entries arrive grouped by key and, within a key, in account order, so each key is looked up once and
+   // its members are appended in place
+   std::sort( entries.begin(), entries.end() );
+   size_t keys = 0;
+   for( auto itr = entries.begin(); itr != entries.end(); ++itr )
+      if( itr == entries.begin() || (itr - 1)->first < itr->first )
+         ++keys;
+   memberships.reserve( memberships.size() + keys );
+   auto next = entries.begin();
+   while( next != entries.end() )
+   {
+      auto end = next;
+      while( end != entries.end() && !(next->first < end->first) )
+         ++end;
+      auto& members = memberships[next->first];
+      members.reserve( members.size() + (end - next) );
+      for( ; next != end; ++next )
+         members.insert( members.end(), next->second );
+   }
+}
+
+static void collect_members( const vector<const object*>& objs,
+                             vector< pair<account_id_type, account_id_type> >& accounts,
+                             vector< pair<public_key_type, account_id_type> >& keys )
+{
+   for( const object* obj : objs )
+   {
+      assert( dynamic_cast<const account_object*>(obj) ); // for debug only
+      const account_object& a = static_cast<const account_object&>(*obj);
+      for( const auto& auth : a.owner.account_auths )
+         accounts.emplace_back( auth.first, a.get_id() );
+      for( const auto& auth : a.owner.key_auths )
+         keys.emplace_back( auth.first, a.get_id() );
+   }
+}
+
+template<typename Key>
+static void apply_change( account_member_index::member_map<Key>& memberships, const Key& key, account_id_type member, bool add )
+{
+   if( add )
+   {
+      memberships[key].insert(member);
+      return;
+   }
+   auto itr = memberships.find(key);
+   if( itr == memberships.end() )
+      return;
+   itr->second.erase(member);
+   if( itr->second.empty() )
+      memberships.erase(itr);
+}
+
+void account_member_index::change_account_member( account_id_type account, account_id_type member, bool add )
+{
+   if( building() )
+      _build->account_changes.emplace_back( account, member, add );
+   else
+      apply_change( account_to_account_memberships, account, member, add );
+}
+
+void account_member_index::change_key_member( const public_key_type& key, account_id_type member, bool add )
+{
+   if( building() )
+      _build->key_changes.emplace_back( key, member, add );
+   else
+      apply_change( account_to_key_memberships, key, member, add );
+}
+
+bool account_member_index::building()const
+{
+   if( _build && _build->done.ready() )
+      finish_build();
+   return _build != nullptr;
+}
+
+void account_member_index::finish_build()const
+{
+   if( !_build )
+      return;
+   std::unique_ptr<build_state> build = std::move( _build );
+   build->done.wait();
+
+   account_to_account_memberships = std::move( build->account_memberships );
+   account_to_key_memberships = std::move( build->key_memberships );
+   for( const auto& change : build->account_changes )
+      apply_change( account_to_account_memberships, std::get<0>(change), std::get<1>(change), std::get<2>(change) );
+   for( const auto& change : build->key_changes )
+      apply_change( account_to_key_memberships, std::get<0>(change), std::get<1>(change), std::get<2>(change) );
+}
+
 void account_member_index::object_inserted(const object& obj)
 {
     assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
@@ -148,11 +275,47 @@ void account_member_index::object_inserted(const object& obj)
 
     auto account_members = get_account_members(a);
     for( auto item : account_members )
-       account_to_account_memberships[item].insert(obj.id);
+       change_account_member( item, obj.id, true );
 
     auto key_members = get_key_members(a);
     for( auto item : key_members )
-       account_to_key_memberships[item].insert(obj.id);
+       change_key_member( item, obj.id, true );
+}
+
+void account_member_index::objects_inserted( const vector<const object*>& objs )
+{
+   if( building() )
+   {
+      secondary_index::objects_inserted( objs );
+      return;
+   }
+   vector< pair<account_id_type, account_id_type> > accounts;
+   vector< pair<public_key_type, account_id_type> > keys;
+   collect_members( objs, accounts, keys );
+   insert_sorted( account_to_account_memberships, accounts );
+   insert_sorted( account_to_key_memberships, keys );
+}
+
+void account_member_index::objects_loaded( const vector<const object*>& objs )
+{
+   if( building() || !account_to_account_memberships.empty() || !account_to_key_memberships.empty() )
+   {
+      objects_inserted( objs );
+      return;
+   }
+   // The objects may change as soon as loading is done, so their members are read now; the sorting and the
+   // building of the maps, which is most of the work, are left to the background thread.
+   std::unique_ptr<build_state> build( new build_state );
+   collect_members( objs, build->account_entries, build->key_entries );
+   build->thread.reset( new fc::thread( "account_member_index" ) );
+   build_state* state = build.get();
+   build->done = build->thread->async( [state]() {
+      insert_sorted( state->account_memberships, state->account_entries );
+      insert_sorted( state->key_memberships, state->key_entries );
+      state->account_entries = decltype( state->account_entries )();
+      state->key_entries = decltype( state->key_entries )();
+   }, "build account_member_index" );
+   _build = std::move( build );
 }
 
 void account_member_index::object_removed(const object& obj)
@@ -162,10 +325,10 @@ void account_member_index::object_removed(const object& obj)
 
     auto key_members = get_key_members(a);
     for( auto item : key_members )
-       account_to_key_memberships[item].erase( obj.id );
+       change_key_member( item, obj.id, false );
     auto account_members = get_account_members(a);
     for( auto item : account_members )
-       account_to_account_memberships[item].erase( obj.id );
+       change_account_member( item, obj.id, false );
 }
 
 void account_member_index::about_to_modify(const object& before)
@@ -191,7 +354,7 @@ void account_member_index::object_modified(const object& after)
                         std::inserter(removed, removed.end()));
 
     for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-       account_to_account_memberships[*itr].erase(after.id);
+       change_account_member( *itr, after.id, false );
 
     vector<object_id_type> added; added.reserve(after_account_members.size());
     std::set_difference(after_account_members.begin(), after_account_members.end(),
@@ -199,7 +362,7 @@ void account_member_index::object_modified(const object& after)
                         std::inserter(added, added.end()));
 
     for( auto itr = added.begin(); itr != added.end(); ++itr )
-       account_to_account_memberships[*itr].insert(after.id);
+       change_account_member( *itr, after.id, true );
     }
 
 
@@ -214,7 +377,7 @@ void account_member_index::object_modified(const object& after)
                         std::inserter(removed, removed.end()));
 
     for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-       account_to_key_memberships[*itr].erase(after.id);
+       change_key_member( *itr, after.id, false );
 
     vector<public_key_type> added; added.reserve(after_key_members.size());
     std::set_difference(after_key_members.begin(), after_key_members.end(),
@@ -222,11 +385,43 @@ void account_member_index::object_modified(const object& after)
                         std::inserter(added, added.end()));
 
     for( auto itr = added.begin(); itr != added.end(); ++itr )
-       account_to_key_memberships[*itr].insert(after.id);
+       change_key_member( *itr, after.id, true );
     }
 
 }
 
+template<typename Key>
+static vector<account_id_type> find_members( const account_member_index::member_map<Key>& memberships, const Key& key )
+{
+   vector<account_id_type> result;
+   auto itr = memberships.find( key );
+   if( itr != memberships.end() )
+      result.assign( itr->second.begin(), itr->second.end() );
+   return result;
+}
+
+vector<account_id_type> account_member_index::get_account_references( account_id_type account )const
+{
+   finish_build();
+   return find_members( account_to_account_memberships, account );
+}
+
+vector<account_id_type> account_member_index::get_key_references( const public_key_type& key )const
+{
+   finish_build();
+   return find_members( account_to_key_memberships, key );
+}
+
+vector<vector<account_id_type>> account_member_index::get_key_references( const vector<public_key_type>& keys )const
+{
+   finish_build();
+   vector<vector<account_id_type>> result;
+   result.reserve( keys.size() );
+   for( const auto& key : keys )
+      result.emplace_back( find_members( account_to_key_memberships, key ) );
+   return result;
+}
+
 void account_referrer_index::object_inserted( const object& obj )
 {
 }
@@ -240,4 +435,20 @@ void account_referrer_index::object_modified( const object& after  )
 {
 }
 
+void pending_fees_index::object_changed( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) );
+   const auto& stats = static_cast<const account_statistics_object&>(obj);
+   if( stats.pending_fees > 0 || stats.pending_vested_fees > 0 )
+      accounts_with_pending_fees.insert( stats.owner );
+   else
+      accounts_with_pending_fees.erase( stats.owner );
+}
+
+void pending_fees_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) );
+   accounts_with_pending_fees.erase( static_cast<const account_statistics_object&>(obj).owner );
+}
+
 } } // graphene::chain
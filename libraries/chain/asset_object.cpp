@@ -37,6 +37,22 @@ share_type asset_bitasset_data_object::max_force_settlement_volume(share_type cu
    return volume.to_uint64();
 }
 
+void graphene::chain::changed_bitasset_index::object_changed( const object& obj )
+{
+   if( obj.id.space() == protocol_ids && obj.id.type() == asset_object_type )
+   {
+      assert( dynamic_cast<const asset_object*>(&obj) );
+      const asset_object& a = static_cast<const asset_object&>(obj);
+      if( a.is_market_issued() )
+         changed_assets.insert( a.id );
+   }
+   else
+   {
+      assert( dynamic_cast<const asset_bitasset_data_object*>(&obj) );
+      changed_assets.insert( static_cast<const asset_bitasset_data_object&>(obj).asset_id );
+   }
+}
+
 void graphene::chain::asset_bitasset_data_object::update_median_feeds(time_point_sec current_time)
 {
    current_feed_publication_time = current_time;
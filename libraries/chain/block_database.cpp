@@ -19,6 +19,23 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/falloc.h>
+#endif
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -27,156 +44,621 @@ struct index_entry
    uint32_t      block_size = 0;
    block_id_type block_id;
 };
+
+/**
+ *  The packed signed_block_header of a block, padded to a fixed size.  A header_size of 0 means the record is empty,
+ *  either because there is no block or because its header does not fit, in which case it is read from the block.
+ */
+struct header_entry
+{
+   static const uint32_t capacity = 228;
+
+   uint32_t      header_size = 0;
+   uint32_t      transaction_count = 0;
+   block_id_type block_id;
+   char          header[capacity];
+};
+
+/** where a compressed chunk is in the chunk file; in a compressed block database block_pos is within the chunk */
+struct chunk_entry
+{
+   uint64_t      chunk_pos = 0;
+   uint32_t      chunk_size = 0;
+   uint32_t      raw_size = 0;
+};
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
+FC_REFLECT( graphene::chain::chunk_entry, (chunk_pos)(chunk_size)(raw_size) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
+/**
+ *  Positional reads and writes, which neither use nor move the file position and so may be issued by several
+ *  threads at once.
+ */
+#ifdef _WIN32
+static int open_file( const fc::path& p, bool truncate )
+{
+   int flags = _O_BINARY | _O_RDWR | _O_CREAT | (truncate ? _O_TRUNC : 0);
+   return _wopen( p.generic_wstring().c_str(), flags, _S_IREAD | _S_IWRITE );
+}
+
+static size_t read_at( int fd, char* data, size_t size, uint64_t pos )
+{
+   OVERLAPPED o = {};
+   o.Offset     = DWORD( pos );
+   o.OffsetHigh = DWORD( pos >> 32 );
+   DWORD done = 0;
+   if( !ReadFile( (HANDLE)_get_osfhandle( fd ), data, DWORD( size ), &done, &o ) )
+      FC_ASSERT( GetLastError() == ERROR_HANDLE_EOF, "Read from block database failed" );
+   return done;
+}
+
+static void truncate_file( int fd, uint64_t size )
+{
+   FC_ASSERT( _chsize_s( fd, size ) == 0, "Unable to truncate block database file" );
+}
+
+static void sync_file( int fd )
+{
+   FC_ASSERT( _commit( fd ) == 0, "Unable to sync block database file" );
+}
+
+static void write_at( int fd, const char* data, size_t size, uint64_t pos )
+{
+   OVERLAPPED o = {};
+   o.Offset     = DWORD( pos );
+   o.OffsetHigh = DWORD( pos >> 32 );
+   DWORD done = 0;
+   FC_ASSERT( WriteFile( (HANDLE)_get_osfhandle( fd ), data, DWORD( size ), &done, &o ) && done == size,
+              "Write to block database failed" );
+}
+
+static bool punch_hole( int fd, uint64_t pos, uint64_t size )
+{
+   HANDLE file = (HANDLE)_get_osfhandle( fd );
+   DWORD done = 0;
+   if( !DeviceIoControl( file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &done, nullptr ) )
+      return false;
+   FILE_ZERO_DATA_INFORMATION zero;
+   zero.FileOffset.QuadPart      = pos;
+   zero.BeyondFinalZero.QuadPart = pos + size;
+   return DeviceIoControl( file, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), nullptr, 0, &done, nullptr );
+}
+#else
+static int open_file( const fc::path& p, bool truncate )
+{
+   return ::open( p.generic_string().c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644 );
+}
+
+static size_t read_at( int fd, char* data, size_t size, uint64_t pos )
+{
+   size_t done = 0;
+   while( done < size )
+   {
+      ssize_t n = ::pread( fd, data + done, size - done, pos + done );
+      if( n < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( n >= 0, "Read from block database failed: ${e}", ("e", std::strerror( errno )) );
+      if( n == 0 )
+         break;
+      done += n;
+   }
+   return done;
+}
+
+static void truncate_file( int fd, uint64_t size )
+{
+   FC_ASSERT( ::ftruncate( fd, size ) == 0, "Unable to truncate block database file: ${e}", ("e", std::strerror( errno )) );
+}
+
+static void sync_file( int fd )
+{
+   FC_ASSERT( ::fsync( fd ) == 0, "Unable to sync block database file: ${e}", ("e", std::strerror( errno )) );
+}
+
+static void write_at( int fd, const char* data, size_t size, uint64_t pos )
+{
+   size_t done = 0;
+   while( done < size )
+   {
+      ssize_t n = ::pwrite( fd, data + done, size - done, pos + done );
+      if( n < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( n > 0, "Write to block database failed: ${e}", ("e", std::strerror( errno )) );
+      done += n;
+   }
+}
+
+static bool punch_hole( int fd, uint64_t pos, uint64_t size )
+{
+#ifdef __linux__
+   return ::fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos, size ) == 0;
+#else
+   return false;
+#endif
+}
+#endif
+
+/**
+ *  Makes a range of a file read as zeros.  Where the file system supports it the range becomes a hole, which frees
+ *  its disk space; otherwise zeros are written over it.
+ */
+static void zero_range( int fd, uint64_t pos, uint64_t size )
+{
+   if( size == 0 || punch_hole( fd, pos, size ) )
+      return;
+   vector<char> zeros( std::min<uint64_t>( size, 1 << 16 ) );
+   for( uint64_t done = 0; done < size; done += zeros.size() )
+      write_at( fd, zeros.data(), std::min<uint64_t>( zeros.size(), size - done ), pos + done );
+}
+
+static vector<char> compress_chunk( const vector<char>& raw )
+{
+   uLongf size = compressBound( raw.size() );
+   vector<char> result( size );
+   int status = compress2( (Bytef*)result.data(), &size, (const Bytef*)raw.data(), raw.size(), Z_DEFAULT_COMPRESSION );
+   FC_ASSERT( status == Z_OK, "Unable to compress block log chunk: zlib error ${s}", ("s", status) );
+   result.resize( size );
+   return result;
+}
+
+static vector<char> decompress_chunk( const vector<char>& packed, uint32_t raw_size )
+{
+   vector<char> result( raw_size );
+   uLongf size = raw_size;
+   int status = uncompress( (Bytef*)result.data(), &size, (const Bytef*)packed.data(), packed.size() );
+   FC_ASSERT( status == Z_OK && size == raw_size, "Unable to decompress block log chunk: zlib error ${s}", ("s", status) );
+   return result;
+}
+
+static optional<signed_block> unpack_block( const char* data, uint32_t size, const block_id_type& id )
+{
+   fc::datastream<const char*> ds( data, size );
+   signed_block result;
+   fc::raw::unpack( ds, result );
+   if( result.id() != id )
+      return optional<signed_block>();
+   return result;
+}
+
+block_database::block_database()
+:_blocks_size(0),_index_size(0),_headers_size(0),_chunks_size(0),_sealed_chunks(0),_last_block_num(0),_first_block_num(1){}
+
+block_database::~block_database()
+{
+   close();
+}
+
+void block_database::open( const fc::path& dbdir, bool compress_new )
 { try {
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   close();
+
+   bool truncate = !fc::exists( dbdir/"index" );
+   _compressed = truncate ? compress_new : fc::exists( dbdir/"chunk_index" );
 
-   if( !fc::exists( dbdir/"index" ) )
+   auto open_or_throw = [&]( const char* name ) {
+      int fd = open_file( dbdir/name, truncate );
+      FC_ASSERT( fd >= 0, "Unable to open ${f}: ${e}", ("f", (dbdir/name).generic_string())("e", std::strerror( errno )) );
+      return fd;
+   };
+   _block_num_to_pos = open_or_throw( "index" );
+   _index_size.store( fc::file_size( dbdir/"index" ) / sizeof(index_entry) * sizeof(index_entry) );
+   // the last entry of the index is the head unless blocks have been removed since it was written
+   uint32_t entries = _index_size.load() / sizeof(index_entry);
+   _last_block_num.store( entries ? last_stored_at_or_before( entries - 1 ) : 0 );
+   _first_block_num.store( first_stored() );
+
+   bool build_headers = !fc::exists( dbdir/"headers" ) && _last_block_num.load() > 0;
+   _headers = open_or_throw( "headers" );
+   _headers_size.store( fc::file_size( dbdir/"headers" ) / sizeof(header_entry) * sizeof(header_entry) );
+
+   if( !_compressed )
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      _blocks = open_or_throw( "blocks" );
+      _blocks_size.store( fc::file_size( dbdir/"blocks" ) );
    }
    else
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      _blocks = open_or_throw( "tail" );
+      _chunks = open_or_throw( "chunks" );
+      _chunk_index = open_or_throw( "chunk_index" );
+      open_chunks( dbdir );
+   }
+
+   // block logs written before headers were kept separately get them once
+   if( build_headers )
+   {
+      ilog( "Indexing the headers of ${n} blocks", ("n", _last_block_num.load()) );
+      for( uint32_t num = _first_block_num.load(); num <= _last_block_num.load(); ++num )
+      {
+         auto b = fetch_by_number( num );
+         if( b )
+            write_header( num, b->id(), &*b );
+      }
    }
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
+void block_database::open_chunks( const fc::path& dbdir )
+{
+   // anything after the last complete chunk entry was being written when the node stopped
+   uint32_t sealed = fc::file_size( dbdir/"chunk_index" ) / sizeof(chunk_entry);
+   truncate_file( _chunk_index, uint64_t( sealed ) * sizeof(chunk_entry) );
+   uint64_t chunks_size = 0;
+   if( sealed > 0 )
+   {
+      chunk_entry last_chunk;
+      FC_ASSERT( read_at( _chunk_index, (char*)&last_chunk, sizeof(last_chunk), uint64_t( sealed - 1 ) * sizeof(last_chunk) )
+                 == sizeof(last_chunk) );
+      chunks_size = last_chunk.chunk_pos + last_chunk.chunk_size;
+   }
+   truncate_file( _chunks, chunks_size );
+   _chunks_size.store( chunks_size );
+   _sealed_chunks.store( sealed );
+
+   // the tail still holds the last sealed chunk if the node stopped right after sealing it
+   if( _last_block_num.load() <= uint64_t( sealed ) * blocks_per_chunk )
+      truncate_file( _blocks, 0 );
+   _blocks_size.store( fc::file_size( dbdir/"tail" ) );
+}
+
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _blocks >= 0;
 }
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+   for( int* fd : { &_blocks, &_block_num_to_pos, &_chunks, &_chunk_index, &_headers } )
+   {
+      if( *fd >= 0 )
+         ::close( *fd );
+      *fd = -1;
+   }
+   _blocks_size.store( 0 );
+   _index_size.store( 0 );
+   _headers_size.store( 0 );
+   _chunks_size.store( 0 );
+   _sealed_chunks.store( 0 );
+   _last_block_num.store( 0 );
+   _first_block_num.store( 1 );
+
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _chunk_cache.clear();
 }
 
+/** every write goes straight to the operating system, so flushing only has to wait for it to reach the disk */
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+   for( int fd : { _blocks, _block_num_to_pos, _chunks, _chunk_index, _headers } )
+      if( fd >= 0 )
+         sync_file( fd );
 }
 
-void block_database::store( const block_id_type& id, const signed_block& b )
+void block_database::set_chunk_cache_size( uint32_t chunks )
 {
-   auto num = block_header::num_from_id(id);
-   _block_num_to_pos.seekp( sizeof( index_entry ) * num );
-   index_entry e;
-   _blocks.seekp( 0, _blocks.end );
-   auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
-   e.block_size = vec.size();
-   e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _chunk_cache_size = chunks;
+   while( _chunk_cache.size() > _chunk_cache_size )
+   {
+      auto oldest = std::min_element( _chunk_cache.begin(), _chunk_cache.end(),
+                                      []( const cached_chunk& a, const cached_chunk& b ) { return a.last_use < b.last_use; } );
+      _chunk_cache.erase( oldest );
+   }
 }
 
-void block_database::remove( const block_id_type& id )
-{ try {
-   index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
-      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+bool block_database::read_entry( uint32_t block_num, index_entry& e )const
+{
+   uint64_t index_pos = uint64_t( sizeof(e) ) * block_num;
+   if( block_num < _first_block_num.load( std::memory_order_acquire ) ||
+       index_pos + sizeof(e) > _index_size.load( std::memory_order_acquire ) )
+      return false;
+   return read_at( _block_num_to_pos, (char*)&e, sizeof(e), index_pos ) == sizeof(e);
+}
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+void block_database::write_entry( uint32_t block_num, const index_entry& e )
+{
+   uint64_t index_pos = uint64_t( sizeof(e) ) * block_num;
+   write_at( _block_num_to_pos, (const char*)&e, sizeof(e), index_pos );
+   if( index_pos + sizeof(e) > _index_size.load( std::memory_order_relaxed ) )
+      _index_size.store( index_pos + sizeof(e), std::memory_order_release );
+}
 
-   if( e.block_id == id )
+void block_database::write_header( uint32_t block_num, const block_id_type& id, const signed_block* b )
+{
+   header_entry h;
+   memset( h.header, 0, sizeof(h.header) );
+   if( b )
    {
-      e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      h.block_id = id;
+      h.transaction_count = b->transactions.size();
+      auto packed = fc::raw::pack( static_cast<const signed_block_header&>( *b ) );
+      if( packed.size() <= header_entry::capacity )
+      {
+         memcpy( h.header, packed.data(), packed.size() );
+         h.header_size = packed.size();
+      }
    }
-} FC_CAPTURE_AND_RETHROW( (id) ) }
+   uint64_t pos = uint64_t( sizeof(h) ) * block_num;
+   write_at( _headers, (const char*)&h, sizeof(h), pos );
+   if( pos + sizeof(h) > _headers_size.load( std::memory_order_relaxed ) )
+      _headers_size.store( pos + sizeof(h), std::memory_order_release );
+}
 
-bool block_database::contains( const block_id_type& id )const
+optional<indexed_block_header> block_database::read_header( uint32_t block_num, const header_entry& h )const
 {
-   index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
-      return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   if( h.header_size > 0 && h.header_size <= header_entry::capacity )
+   {
+      try
+      {
+         indexed_block_header result;
+         fc::datastream<const char*> ds( h.header, h.header_size );
+         fc::raw::unpack( ds, static_cast<signed_block_header&>( result ) );
+         if( result.id() == h.block_id )
+         {
+            result.block_id = h.block_id;
+            result.transaction_count = h.transaction_count;
+            return result;
+         }
+      }
+      catch (const fc::exception&)
+      {
+      }
+   }
+   auto b = fetch_by_number( block_num );
+   if( !b )
+      return optional<indexed_block_header>();
+   return indexed_block_header( *b, b->id() );
+}
 
-   return e.block_id == id;
+optional<indexed_block_header> block_database::fetch_header_by_number( uint32_t block_num )const
+{
+   header_entry h;
+   uint64_t pos = uint64_t( sizeof(h) ) * block_num;
+   if( pos + sizeof(h) > _headers_size.load( std::memory_order_acquire ) ||
+       read_at( _headers, (char*)&h, sizeof(h), pos ) != sizeof(h) )
+      h.header_size = 0;
+   return read_header( block_num, h );
 }
 
-block_id_type block_database::fetch_block_id( uint32_t block_num )const
+vector<indexed_block_header> block_database::fetch_headers( uint32_t first_num, uint32_t count )const
 {
-   index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
-      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
+   vector<indexed_block_header> result;
+   uint64_t records = _headers_size.load( std::memory_order_acquire ) / sizeof(header_entry);
+   if( first_num < _first_block_num.load( std::memory_order_acquire ) || first_num >= records )
+      return result;
+   count = std::min<uint64_t>( count, records - first_num );
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   vector<header_entry> headers( count );
+   size_t bytes = read_at( _headers, (char*)headers.data(), count * sizeof(header_entry),
+                           uint64_t( sizeof(header_entry) ) * first_num );
+   headers.resize( bytes / sizeof(header_entry) );
 
-   return e.block_id;
+   result.reserve( headers.size() );
+   for( uint32_t i = 0; i < headers.size(); ++i )
+   {
+      auto header = read_header( first_num + i, headers[i] );
+      if( !header )
+         break;
+      result.push_back( std::move( *header ) );
+   }
+   return result;
 }
 
-optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+uint32_t block_database::last_stored_at_or_before( uint32_t block_num )const
 {
-   try
+   index_entry e;
+   for( ; block_num > 0; --block_num )
+      if( read_entry( block_num, e ) && e.block_size != 0 )
+         return block_num;
+   return 0;
+}
+
+uint32_t block_database::first_stored()const
+{
+   index_entry e;
+   uint32_t low = 1;
+   uint32_t high = _last_block_num.load( std::memory_order_relaxed );
+   if( high == 0 )
+      return 1;
+   // the pruned entries are all below the stored ones
+   while( low < high )
    {
-      index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
+      uint32_t mid = low + (high - low) / 2;
+      if( read_entry( mid, e ) && e.block_size != 0 )
+         high = mid;
+      else
+         low = mid + 1;
+   }
+   return low;
+}
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+void block_database::prune( uint32_t first_num )
+{ try {
+   const uint32_t old_first = _first_block_num.load( std::memory_order_relaxed );
+   index_entry old_entry, new_entry;
+   if( !read_entry( old_first, old_entry ) || old_entry.block_size == 0 ||
+       !read_entry( first_num, new_entry ) || new_entry.block_size == 0 )
+      return;
 
-      if( e.block_id != id ) return optional<signed_block>();
+   // readers stop looking below the new first block before any of the space is reused; a reader which already
+   // passed that check reads zeros and finds nothing, as every read is checked against the id in the index
+   _first_block_num.store( first_num, std::memory_order_release );
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+   // blocks are only removed from the end, so the data of every retained block follows that of the pruned ones
+   bool punched = true;
+   if( !_compressed )
+   {
+      if( new_entry.block_pos > old_entry.block_pos )
+         punched = punch_hole( _blocks, old_entry.block_pos, new_entry.block_pos - old_entry.block_pos );
    }
-   catch (const fc::exception&)
+   else
    {
+      // only whole chunks are pruned, and the chunk of the new first block is kept
+      const uint32_t old_chunk = chunk_of( old_first );
+      const uint32_t new_chunk = chunk_of( first_num );
+      if( new_chunk > old_chunk )
+      {
+         chunk_entry old_ce;
+         FC_ASSERT( read_at( _chunk_index, (char*)&old_ce, sizeof(old_ce), uint64_t( old_chunk ) * sizeof(old_ce) )
+                    == sizeof(old_ce) );
+         uint64_t end = _chunks_size.load( std::memory_order_relaxed );
+         chunk_entry new_ce;
+         if( new_chunk < _sealed_chunks.load( std::memory_order_relaxed ) &&
+             read_at( _chunk_index, (char*)&new_ce, sizeof(new_ce), uint64_t( new_chunk ) * sizeof(new_ce) ) == sizeof(new_ce) )
+            end = new_ce.chunk_pos;
+         if( end > old_ce.chunk_pos )
+            punched = punch_hole( _chunks, old_ce.chunk_pos, end - old_ce.chunk_pos );
+         zero_range( _chunk_index, uint64_t( old_chunk ) * sizeof(chunk_entry), uint64_t( new_chunk - old_chunk ) * sizeof(chunk_entry) );
+
+         std::lock_guard<std::mutex> lock( _cache_mutex );
+         _chunk_cache.erase( std::remove_if( _chunk_cache.begin(), _chunk_cache.end(),
+                                             [new_chunk]( const cached_chunk& c ) { return c.chunk < new_chunk; } ),
+                             _chunk_cache.end() );
+      }
    }
-   catch (const std::exception&)
+   punched = punch_hole( _headers, uint64_t( old_first ) * sizeof(header_entry),
+                         uint64_t( first_num - old_first ) * sizeof(header_entry) ) && punched;
+   // the index goes last, so that pruning which was interrupted is resumed from the same first block
+   zero_range( _block_num_to_pos, uint64_t( old_first ) * sizeof(index_entry),
+               uint64_t( first_num - old_first ) * sizeof(index_entry) );
+
+   if( !punched && !_warned_no_hole_punching )
    {
+      wlog( "The file system does not support freeing part of a file, so pruned blocks still take up disk space" );
+      _warned_no_hole_punching = true;
    }
-   return optional<signed_block>();
+} FC_CAPTURE_AND_RETHROW( (first_num) ) }
+
+void block_database::cache_chunk( uint32_t chunk, const chunk_data& data )const
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   if( _chunk_cache_size == 0 )
+      return;
+   for( auto& c : _chunk_cache )
+      if( c.chunk == chunk )
+      {
+         c.data = data;
+         c.last_use = ++_cache_clock;
+         return;
+      }
+   if( _chunk_cache.size() >= _chunk_cache_size )
+   {
+      auto oldest = std::min_element( _chunk_cache.begin(), _chunk_cache.end(),
+                                      []( const cached_chunk& a, const cached_chunk& b ) { return a.last_use < b.last_use; } );
+      _chunk_cache.erase( oldest );
+   }
+   cached_chunk c;
+   c.chunk = chunk;
+   c.last_use = ++_cache_clock;
+   c.data = data;
+   _chunk_cache.push_back( std::move( c ) );
 }
 
-optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+block_database::chunk_data block_database::load_chunk( uint32_t chunk )const
 {
-   try
    {
-      index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
+      std::lock_guard<std::mutex> lock( _cache_mutex );
+      for( auto& c : _chunk_cache )
+         if( c.chunk == chunk )
+         {
+            c.last_use = ++_cache_clock;
+            return c.data;
+         }
+   }
+
+   // decompress outside of the lock, so that readers of other chunks are not held up
+   chunk_entry ce;
+   if( read_at( _chunk_index, (char*)&ce, sizeof(ce), uint64_t( chunk ) * sizeof(ce) ) != sizeof(ce) ||
+       ce.chunk_size == 0 || ce.chunk_pos + ce.chunk_size > _chunks_size.load( std::memory_order_acquire ) )
+      return chunk_data();
+   vector<char> packed( ce.chunk_size );
+   if( read_at( _chunks, packed.data(), packed.size(), ce.chunk_pos ) != packed.size() )
+      return chunk_data();
+   auto data = std::make_shared<const vector<char>>( decompress_chunk( packed, ce.raw_size ) );
+   cache_chunk( chunk, data );
+   return data;
+}
+
+void block_database::seal_chunk()
+{
+   const uint32_t chunk = _sealed_chunks.load( std::memory_order_relaxed );
+   auto raw = std::make_shared<vector<char>>( _blocks_size.load( std::memory_order_relaxed ) );
+   FC_ASSERT( read_at( _blocks, raw->data(), raw->size(), 0 ) == raw->size() );
+   auto packed = compress_chunk( *raw );
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   chunk_entry ce;
+   ce.chunk_pos  = _chunks_size.load( std::memory_order_relaxed );
+   ce.chunk_size = packed.size();
+   ce.raw_size   = raw->size();
+   write_at( _chunks, packed.data(), packed.size(), ce.chunk_pos );
+   _chunks_size.store( ce.chunk_pos + packed.size(), std::memory_order_release );
+   write_at( _chunk_index, (const char*)&ce, sizeof(ce), uint64_t( chunk ) * sizeof(ce) );
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+   // the chunk is readable before the tail is reused; a reader which loses the race retries in the chunk
+   cache_chunk( chunk, raw );
+   _sealed_chunks.store( chunk + 1, std::memory_order_release );
+   truncate_file( _blocks, 0 );
+   _blocks_size.store( 0, std::memory_order_release );
+}
+
+void block_database::unseal_chunk()
+{
+   const uint32_t chunk = _sealed_chunks.load( std::memory_order_relaxed ) - 1;
+   auto raw = load_chunk( chunk );
+   FC_ASSERT( raw, "Unable to read block log chunk ${c}", ("c", chunk) );
+   chunk_entry ce;
+   FC_ASSERT( read_at( _chunk_index, (char*)&ce, sizeof(ce), uint64_t( chunk ) * sizeof(ce) ) == sizeof(ce) );
+
+   truncate_file( _blocks, 0 );
+   write_at( _blocks, raw->data(), raw->size(), 0 );
+   _blocks_size.store( raw->size(), std::memory_order_release );
+   _sealed_chunks.store( chunk, std::memory_order_release );
+
+   truncate_file( _chunk_index, uint64_t( chunk ) * sizeof(ce) );
+   truncate_file( _chunks, ce.chunk_pos );
+   _chunks_size.store( ce.chunk_pos, std::memory_order_release );
+
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _chunk_cache.erase( std::remove_if( _chunk_cache.begin(), _chunk_cache.end(),
+                                       [chunk]( const cached_chunk& c ) { return c.chunk == chunk; } ),
+                       _chunk_cache.end() );
+}
+
+optional<signed_block> block_database::read_block( uint32_t block_num, const index_entry& e )const
+{
+   try
+   {
+      if( e.block_size == 0 )
+         return optional<signed_block>();
+
+      // a block read from the tail of a compressed block database may be sealed into a chunk meanwhile
+      for( int attempt = 0; attempt < 2; ++attempt )
+      {
+         if( _compressed && chunk_of( block_num ) < _sealed_chunks.load( std::memory_order_acquire ) )
+         {
+            auto data = load_chunk( chunk_of( block_num ) );
+            if( data && e.block_pos + e.block_size <= data->size() )
+            {
+               auto result = unpack_block( data->data() + e.block_pos, e.block_size, e.block_id );
+               if( result )
+                  return result;
+            }
+         }
+         else if( e.block_pos + e.block_size <= _blocks_size.load( std::memory_order_acquire ) )
+         {
+            vector<char> data( e.block_size );
+            if( read_at( _blocks, data.data(), e.block_size, e.block_pos ) == e.block_size )
+            {
+               auto result = unpack_block( data.data(), e.block_size, e.block_id );
+               if( result )
+                  return result;
+            }
+         }
+         if( !_compressed )
+            break;
+      }
    }
    catch (const fc::exception&)
    {
@@ -187,39 +669,139 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<signed_block> block_database::last()const
+void block_database::store( const block_id_type& id, const signed_block& b )
 {
-   try
+   auto num = block_header::num_from_id(id);
+   if( _compressed )
+      FC_ASSERT( chunk_of( num ) == _sealed_chunks.load( std::memory_order_relaxed ),
+                 "Blocks can only be appended to a compressed block database", ("block_num", num) );
+
+   auto vec = fc::raw::pack( b );
+   index_entry e;
+   e.block_pos  = _blocks_size.load( std::memory_order_relaxed );
+   e.block_size = vec.size();
+   e.block_id   = id;
+
+   // the data must be readable before the index entry which points to it
+   write_at( _blocks, vec.data(), vec.size(), e.block_pos );
+   _blocks_size.store( e.block_pos + vec.size(), std::memory_order_release );
+   write_header( num, id, &b );
+   write_entry( num, e );
+
+   if( num > _last_block_num.load( std::memory_order_relaxed ) )
+      _last_block_num.store( num, std::memory_order_release );
+
+   if( _compressed && num % blocks_per_chunk == 0 )
+      seal_chunk();
+
+   if( _retain_blocks > 0 && num > _retain_blocks )
    {
-      index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      uint32_t first_num = num - _retain_blocks + 1;
+      if( _compressed )
+         first_num = chunk_of( first_num ) * blocks_per_chunk + 1;
+      if( first_num >= _first_block_num.load( std::memory_order_relaxed ) + blocks_per_chunk )
+         prune( first_num );
+   }
+}
 
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<signed_block>();
+void block_database::start_at( uint32_t first_num )
+{ try {
+   FC_ASSERT( first_num > 0 );
+   FC_ASSERT( _last_block_num.load( std::memory_order_relaxed ) == 0, "Only an empty block database can begin at a later block" );
+   if( _compressed )
+   {
+      // the chunks before the first block are empty entries, like pruned ones, so the next chunk sealed is the right one
+      const uint32_t chunk = chunk_of( first_num );
+      truncate_file( _chunk_index, uint64_t( chunk ) * sizeof(chunk_entry) );
+      _sealed_chunks.store( chunk, std::memory_order_release );
+   }
+   _first_block_num.store( first_num, std::memory_order_release );
+} FC_CAPTURE_AND_RETHROW( (first_num) ) }
 
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      while( e.block_size == 0 && _blocks.tellg() > 0 )
+void block_database::remove( const block_id_type& id )
+{ try {
+   index_entry e;
+   auto num = block_header::num_from_id(id);
+   if( !read_entry( num, e ) )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+
+   if( e.block_id == id )
+   {
+      if( _compressed && chunk_of( num ) < _sealed_chunks.load( std::memory_order_relaxed ) )
       {
-         _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.cur );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
+         FC_ASSERT( chunk_of( num ) + 1 == _sealed_chunks.load( std::memory_order_relaxed ) &&
+                    _last_block_num.load( std::memory_order_relaxed ) <= uint64_t( chunk_of( num ) + 1 ) * blocks_per_chunk,
+                    "Only the last blocks can be removed from a compressed block database", ("block_num", num) );
+         unseal_chunk();
       }
+      e.block_size = 0;
+      write_entry( num, e );
+      write_header( num, id, nullptr );
+      if( num == _last_block_num.load( std::memory_order_relaxed ) )
+         _last_block_num.store( last_stored_at_or_before( num ), std::memory_order_release );
+   }
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+bool block_database::contains( const block_id_type& id )const
+{
+   index_entry e;
+   if( !read_entry( block_header::num_from_id(id), e ) )
+      return false;
+   return e.block_size != 0 && e.block_id == id;
+}
 
-      if( e.block_size == 0 )
-         return optional<signed_block>();
+block_id_type block_database::fetch_block_id( uint32_t block_num )const
+{
+   index_entry e;
+   if( !read_entry( block_num, e ) || e.block_size == 0 )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
+   return e.block_id;
+}
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+vector<block_id_type> block_database::fetch_block_ids( uint32_t first_num, uint32_t count )const
+{
+   vector<block_id_type> result;
+   uint64_t entries = _index_size.load( std::memory_order_acquire ) / sizeof(index_entry);
+   if( first_num < _first_block_num.load( std::memory_order_acquire ) || first_num >= entries )
       return result;
-   }
-   catch (const fc::exception&)
-   {
-   }
-   catch (const std::exception&)
+   count = std::min<uint64_t>( count, entries - first_num );
+
+   vector<index_entry> block_entries( count );
+   size_t bytes = read_at( _block_num_to_pos, (char*)block_entries.data(), count * sizeof(index_entry),
+                           uint64_t( sizeof(index_entry) ) * first_num );
+   block_entries.resize( bytes / sizeof(index_entry) );
+
+   result.reserve( block_entries.size() );
+   for( const auto& e : block_entries )
    {
+      if( e.block_size == 0 )
+         break;
+      result.push_back( e.block_id );
    }
-   return optional<signed_block>();
+   return result;
+}
+
+optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+{
+   index_entry e;
+   auto num = block_header::num_from_id(id);
+   if( !read_entry( num, e ) || e.block_id != id )
+      return optional<signed_block>();
+   return read_block( num, e );
+}
+
+optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+{
+   index_entry e;
+   if( !read_entry( block_num, e ) )
+      return optional<signed_block>();
+   return read_block( block_num, e );
+}
+
+optional<signed_block> block_database::last()const
+{
+   uint32_t num = last_block_num();
+   if( num == 0 )
+      return optional<signed_block>();
+   return fetch_by_number( num );
 }
 } }
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/block_prefetcher.hpp>
+
+#include <fc/thread/thread.hpp>
+
+namespace graphene { namespace chain {
+
+block_prefetcher::block_prefetcher( const block_database& blocks, uint32_t first_num, uint32_t last_num,
+                                    uint32_t thread_count, uint32_t queue_depth, bool recover_signatures )
+:_blocks(blocks),_last_num(last_num),_queue_depth(std::max<uint32_t>( queue_depth, 1 )),
+ _recover_signatures(recover_signatures),_next_to_read(first_num),_read_time(0)
+{
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _threads.emplace_back( new fc::thread( "prefetch" + fc::to_string( uint64_t(i) ) ) );
+   fill();
+}
+
+block_prefetcher::~block_prefetcher()
+{
+   for( auto& f : _queue )
+   {
+      try {
+         f.wait();
+      } catch( ... ) {
+      }
+   }
+}
+
+prefetched_block block_prefetcher::read( uint32_t block_num )
+{
+   auto start = fc::time_point::now();
+   prefetched_block result;
+   auto b = _blocks.fetch_by_number( block_num );
+   FC_ASSERT( b.valid(), "Unable to read block ${n} from the block log", ("n", block_num) );
+   result.block = std::move( *b );
+   if( _recover_signatures )
+   {
+      result.signee = public_key_type( result.block.signee() );
+      // recovering the keys checks that every signature is canonical and that none is repeated
+      for( const auto& trx : result.block.transactions )
+         trx.get_signature_keys();
+   }
+   _read_time.fetch_add( (fc::time_point::now() - start).count(), std::memory_order_relaxed );
+   return result;
+}
+
+void block_prefetcher::fill()
+{
+   if( _threads.empty() )
+      return;
+   // blocks are handed to the threads in turn, so consecutive blocks are read at the same time
+   while( _queue.size() < _queue_depth && _next_to_read <= _last_num )
+   {
+      uint32_t block_num = _next_to_read++;
+      auto& thread = *_threads[block_num % _threads.size()];
+      _queue.push_back( thread.async( [this, block_num]() { return read( block_num ); }, "prefetch_block" ) );
+   }
+}
+
+optional<prefetched_block> block_prefetcher::next()
+{
+   auto start = fc::time_point::now();
+   optional<prefetched_block> result;
+   if( _threads.empty() )
+   {
+      if( _next_to_read <= _last_num )
+         result = read( _next_to_read++ );
+   }
+   else if( !_queue.empty() )
+   {
+      auto f = std::move( _queue.front() );
+      _queue.pop_front();
+      result = f.wait();
+      fill();
+   }
+   _wait_time += fc::time_point::now() - start;
+   return result;
+}
+
+} } // graphene::chain
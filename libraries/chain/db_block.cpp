@@ -46,25 +46,151 @@ bool database::is_known_transaction( const transaction_id_type& id )const
 
 block_id_type  database::get_block_id_for_num( uint32_t block_num )const
 { try {
+   if( block_num > _last_stored_block_num )
+   {
+      auto item = fetch_reversible_block( block_num );
+      FC_ASSERT( item, "Block number ${block_num} is not on the current chain", ("block_num", block_num) );
+      return item->id;
+   }
+   GRAPHENE_ASSERT( block_num >= earliest_available_block_num(), block_pruned_exception,
+                    "Block number ${block_num} has been pruned from the block log", ("block_num", block_num) );
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+vector<block_id_type> database::get_block_ids_for_nums( uint32_t first_num, uint32_t count )const
+{ try {
+   vector<block_id_type> result;
+   if( first_num == 0 || first_num > head_block_num() )
+      return result;
+   count = std::min( count, head_block_num() - first_num + 1 );
+
+   uint32_t stored_count = 0;
+   if( first_num <= _last_stored_block_num )
+      stored_count = std::min( count, _last_stored_block_num - first_num + 1 );
+   if( stored_count > 0 )
+   {
+      result = _block_id_to_block.fetch_block_ids( first_num, stored_count );
+      if( result.size() < stored_count || stored_count == count )
+         return result;
+   }
+
+   // the rest are reversible; collect them walking back from the head once
+   uint32_t last_num = first_num + count - 1;
+   uint32_t next_num = first_num + stored_count;
+   vector<block_id_type> reversible;
+   auto item = fetch_reversible_block( last_num );
+   while( item && item->num >= next_num )
+   {
+      reversible.push_back( item->id );
+      item = item->prev.lock();
+   }
+   if( reversible.size() == last_num - next_num + 1 )
+      result.insert( result.end(), reversible.rbegin(), reversible.rend() );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (first_num)(count) ) }
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
    auto b = _fork_db.fetch_block( id );
    if( !b )
       return _block_id_to_block.fetch_optional(id);
-   return b->data;
+   return *b->data;
 }
 
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
 {
-   auto results = _fork_db.fetch_block_by_number(num);
-   if( results.size() == 1 )
-      return results[0]->data;
-   else
-      return _block_id_to_block.fetch_by_number(num);
-   return optional<signed_block>();
+   if( num > _last_stored_block_num )
+   {
+      auto item = fetch_reversible_block( num );
+      if( item )
+         return *item->data;
+      return optional<signed_block>();
+   }
+   return _block_id_to_block.fetch_by_number(num);
+}
+
+optional<indexed_block_header> database::fetch_block_header_by_number( uint32_t num )const
+{
+   if( num > _last_stored_block_num )
+   {
+      auto item = fetch_reversible_block( num );
+      if( item )
+         return indexed_block_header( *item->data, item->id );
+      return optional<indexed_block_header>();
+   }
+   return _block_id_to_block.fetch_header_by_number( num );
+}
+
+vector<indexed_block_header> database::fetch_block_headers( uint32_t first_num, uint32_t count )const
+{ try {
+   vector<indexed_block_header> result;
+   if( first_num == 0 || first_num > head_block_num() )
+      return result;
+   count = std::min( count, head_block_num() - first_num + 1 );
+
+   uint32_t stored_count = 0;
+   if( first_num <= _last_stored_block_num )
+      stored_count = std::min( count, _last_stored_block_num - first_num + 1 );
+   if( stored_count > 0 )
+   {
+      result = _block_id_to_block.fetch_headers( first_num, stored_count );
+      if( result.size() < stored_count || stored_count == count )
+         return result;
+   }
+
+   // the rest are reversible; collect them walking back from the head once
+   uint32_t last_num = first_num + count - 1;
+   uint32_t next_num = first_num + stored_count;
+   vector<shared_ptr<fork_item>> reversible;
+   auto item = fetch_reversible_block( last_num );
+   while( item && item->num >= next_num )
+   {
+      reversible.push_back( item );
+      item = item->prev.lock();
+   }
+   if( reversible.size() == last_num - next_num + 1 )
+      for( auto ritr = reversible.rbegin(); ritr != reversible.rend(); ++ritr )
+         result.emplace_back( *(*ritr)->data, (*ritr)->id );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (first_num)(count) ) }
+
+shared_ptr<fork_item> database::fetch_reversible_block( uint32_t num )const
+{
+   if( num > head_block_num() )
+      return shared_ptr<fork_item>();
+   auto item = _fork_db.fetch_block( head_block_id() );
+   while( item && item->num > num )
+      item = item->prev.lock();
+   if( item && item->num == num )
+      return item;
+   return shared_ptr<fork_item>();
+}
+
+void database::store_blocks_through( uint32_t block_num )
+{
+   if( block_num <= _last_stored_block_num )
+      return;
+
+   vector<shared_ptr<fork_item>> blocks;
+   auto item = fetch_reversible_block( block_num );
+   while( item && item->num > _last_stored_block_num )
+   {
+      blocks.push_back( item );
+      item = item->prev.lock();
+   }
+   // oldest first, so that the block log only ever grows at its end
+   for( auto ritr = blocks.rbegin(); ritr != blocks.rend(); ++ritr )
+   {
+      if( (*ritr)->num != _last_stored_block_num + 1 )
+         break;
+      _block_id_to_block.store( (*ritr)->id, *(*ritr)->data );
+      _last_stored_block_num = (*ritr)->num;
+   }
+}
+
+uint32_t database::earliest_available_block_num()const
+{
+   return _block_id_to_block.first_block_num();
 }
 
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
@@ -99,26 +225,33 @@ bool database::_push_block(const signed_block& new_block)
    {
       shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
-      if( new_head->data.previous != head_block_id() )
+      if( new_head->data->previous != head_block_id() )
       {
          //If the newly pushed block is the same height as head, we get head back in new_head
          //Only switch forks if new_head is actually higher than head
-         if( new_head->data.block_num() > head_block_num() )
+         if( new_head->num > head_block_num() )
          {
-            auto branches = _fork_db.fetch_branch_from(new_head->data.id(), _pending_block.previous);
+            auto switch_start = fc::time_point::now();
+            uint32_t popped = 0, replayed = 0;
+            auto branches = _fork_db.fetch_branch_from(new_head->id, _pending_block.previous);
 
             // pop blocks until we hit the forked block
-            while( head_block_id() != branches.second.back()->data.previous )
+            while( head_block_id() != branches.second.back()->data->previous )
+            {
                pop_block();
+               ++popped;
+            }
 
-            // push all blocks on the new fork
+            // push all blocks on the new fork, replaying the changes of those which were applied before
             for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
             {
                 optional<fc::exception> except;
                 try {
                    undo_database::session session = _undo_db.start_undo_session();
-                   apply_block( (*ritr)->data, skip );
-                   _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
+                   if( apply_popped_block( *(*ritr)->data, (*ritr)->id ) )
+                      ++replayed;
+                   else
+                      apply_block( *(*ritr)->data, skip );
                    session.commit();
                 }
                 catch ( const fc::exception& e ) { except = e; }
@@ -127,26 +260,35 @@ bool database::_push_block(const signed_block& new_block)
                    // remove the rest of branches.first from the fork_db, those blocks are invalid
                    while( ritr != branches.first.rend() )
                    {
-                      _fork_db.remove( (*ritr)->data.id() );
+                      _fork_db.remove( (*ritr)->id );
                       ++ritr;
                    }
                    _fork_db.set_head( branches.second.front() );
 
                    // pop all blocks from the bad fork
-                   while( head_block_id() != branches.second.back()->data.previous )
+                   while( head_block_id() != branches.second.back()->data->previous )
                       pop_block();
 
-                   // restore all blocks from the good fork
+                   // restore all blocks from the good fork; their changes were cached when they were popped
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
                    {
                       auto session = _undo_db.start_undo_session();
-                      apply_block( (*ritr)->data, skip );
-                      _block_id_to_block.store( new_block.id(), (*ritr)->data );
+                      if( !apply_popped_block( *(*ritr)->data, (*ritr)->id ) )
+                         apply_block( *(*ritr)->data, skip );
                       session.commit();
                    }
+                   _last_fork_switch_duration = fc::time_point::now() - switch_start;
+                   wlog( "Failed to switch forks at block ${n}; restored the original fork in ${t} ms",
+                         ("n", new_head->num)("t", _last_fork_switch_duration.count() / 1000) );
                    throw *except;
                 }
             }
+            store_blocks_through( last_irreversible_block_num() );
+            _fork_db.prune( last_irreversible_block_num() );
+            _last_fork_switch_duration = fc::time_point::now() - switch_start;
+            ilog( "Switched forks at block ${n}: popped ${p} blocks, applied ${a} (${r} replayed from cache) in ${t} ms",
+                  ("n", new_head->num)("p", popped)("a", branches.first.size())("r", replayed)
+                  ("t", _last_fork_switch_duration.count() / 1000) );
             return true;
          }
          else return false;
@@ -161,13 +303,34 @@ bool database::_push_block(const signed_block& new_block)
    try {
       auto session = _undo_db.start_undo_session();
       apply_block(new_block, skip);
-      _block_id_to_block.store(new_block.id(), new_block);
+      // without the fork database nothing else holds the block, so it is written right away
+      if( skip & skip_fork_db )
+      {
+         _block_id_to_block.store(new_block.id(), new_block);
+         _last_stored_block_num = new_block.block_num();
+      }
       session.commit();
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
       _fork_db.remove(new_block.id());
       throw;
    }
+   if( !(skip&skip_fork_db) )
+   {
+      store_blocks_through( last_irreversible_block_num() );
+      _fork_db.prune( last_irreversible_block_num() );
+   }
+
+   if( _state_checkpoint_interval > 0 && head_block_num() >= _last_checkpoint_block_num + _state_checkpoint_interval )
+   {
+      // the block is in; failing to save a checkpoint only means a longer replay after a crash
+      try {
+         write_state_checkpoint();
+      } catch( const fc::exception& e ) {
+         elog( "Unable to write a state checkpoint: ${e}", ("e", e.to_detail_string()) );
+         _last_checkpoint_block_num = head_block_num();
+      }
+   }
 
    return false;
 } FC_CAPTURE_AND_RETHROW( (new_block) ) }
@@ -198,8 +361,7 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_block_session ) _pending_block_session = _undo_db.start_undo_session();
    auto session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
-   _pending_block.transactions.push_back(processed_trx);
+   _pending_block.transactions.push_back( _apply_transaction( trx ) );
 
    FC_ASSERT( (skip & skip_block_size_check) ||
               fc::raw::pack_size(_pending_block) <= get_global_properties().parameters.maximum_block_size );
@@ -207,7 +369,7 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
    session.merge();
-   return processed_trx;
+   return _pending_block.transactions.back();
 }
 
 processed_transaction database::push_proposal(const proposal_object& proposal)
@@ -317,13 +479,103 @@ signed_block database::_generate_block(
 void database::pop_block()
 { try {
    _pending_block_session.reset();
-   _block_id_to_block.remove( _pending_block.previous );
-   pop_undo();
+   const block_id_type popped_id = _pending_block.previous;
+   const uint32_t popped_num = block_header::num_from_id( popped_id );
+   if( popped_num <= _last_stored_block_num )
+   {
+      _block_id_to_block.remove( popped_id );
+      _last_stored_block_num = popped_num - 1;
+   }
+   // blocks undone along with their session, rather than popped, leave their entries behind
+   while( !_applied_blocks.empty() && block_header::num_from_id( _applied_blocks.back().first ) > popped_num )
+      _applied_blocks.pop_back();
+   if( _popped_block_cache_size > 0 && !_applied_blocks.empty() && _applied_blocks.back().first == popped_id )
+   {
+      popped_block popped = std::move( _applied_blocks.back().second );
+      _applied_blocks.pop_back();
+      // the changes of a block applied with observers were captured before they ran, and theirs are simply undone
+      if( popped.changes_captured )
+         pop_undo();
+      else
+      {
+         _undo_db.pop_commit( &popped.changes );
+         popped.changes_captured = true;
+      }
+
+      auto order_itr = std::find( _popped_block_order.begin(), _popped_block_order.end(), popped_id );
+      if( order_itr != _popped_block_order.end() )
+         _popped_block_order.erase( order_itr );
+      _popped_block_order.push_back( popped_id );
+      _popped_blocks[popped_id] = std::move( popped );
+      while( _popped_block_order.size() > _popped_block_cache_size )
+      {
+         _popped_blocks.erase( _popped_block_order.front() );
+         _popped_block_order.pop_front();
+      }
+   }
+   else
+      pop_undo();
    _pending_block.previous  = head_block_id();
    _pending_block.timestamp = head_block_time();
    _fork_db.pop_block();
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::set_popped_block_cache_size( uint32_t blocks )
+{
+   _popped_block_cache_size = blocks;
+   if( blocks == 0 )
+      _applied_blocks.clear();
+   while( _popped_block_order.size() > _popped_block_cache_size )
+   {
+      _popped_blocks.erase( _popped_block_order.front() );
+      _popped_block_order.pop_front();
+   }
+}
+
+bool database::apply_popped_block( const signed_block& b, const block_id_type& id )
+{ try {
+   auto itr = _popped_blocks.find( id );
+   if( itr == _popped_blocks.end() )
+      return false;
+   FC_ASSERT( b.previous == head_block_id() );
+
+   popped_block redone = std::move( itr->second );
+   _popped_blocks.erase( itr );
+   _popped_block_order.erase( std::find( _popped_block_order.begin(), _popped_block_order.end(), id ) );
+
+   _undo_db.redo( redone.changes );
+
+   // what apply_block does outside of the object database
+   const auto& dgp = get_dynamic_global_properties();
+   FC_ASSERT( dgp.head_block_id == id );
+   _undo_db.set_max_size( dgp.head_block_number - dgp.last_irreversible_block_num + 1 );
+   // the bitassets the block changed were brought up to date when it was applied, as update_expired_feeds leaves them
+   _changed_bitassets->changed_assets.clear();
+
+   // the observers make their changes again, since they are not part of the cached ones
+   _applied_ops = std::move( redone.applied_ops );
+   applied_block( b ); //emit
+   redone.applied_ops = std::move( _applied_ops );
+   _applied_ops.clear();
+
+   notify_changed_objects();
+   update_pending_block( b, redone.block_interval );
+   remember_applied_block( id, std::move( redone ) );
+   return true;
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+void database::remember_applied_block( const block_id_type& id, popped_block&& applied )
+{
+   const uint32_t num = block_header::num_from_id( id );
+   // a block applied at the same height or below replaces the blocks which were undone without being popped
+   while( !_applied_blocks.empty() && block_header::num_from_id( _applied_blocks.back().first ) >= num )
+      _applied_blocks.pop_back();
+   _applied_blocks.emplace_back( id, std::move( applied ) );
+   // blocks beyond the reach of the undo history can no longer be popped
+   while( _applied_blocks.size() > _undo_db.max_size() )
+      _applied_blocks.pop_front();
+}
+
 void database::clear_pending()
 { try {
    _pending_block.transactions.clear();
@@ -333,6 +585,17 @@ void database::clear_pending()
 uint32_t database::push_applied_operation( const operation& op )
 {
    _applied_ops.emplace_back(op);
+   return stamp_applied_operation();
+}
+
+uint32_t database::push_applied_operation( operation&& op )
+{
+   _applied_ops.emplace_back( std::move(op) );
+   return stamp_applied_operation();
+}
+
+uint32_t database::stamp_applied_operation()
+{
    auto& oh = _applied_ops.back();
    oh.block_num    = _current_block_num;
    oh.trx_in_block = _current_trx_in_block;
@@ -385,11 +648,19 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
    return;
 }
 
-void database::_apply_block( const signed_block& next_block )
+template<uint32_t StaticSkip>
+void database::_apply_block_impl( const signed_block& next_block )
 { try {
-   uint32_t skip = get_node_properties().skip_flags;
+   const uint32_t skip = get_node_properties().skip_flags | StaticSkip;
    _applied_ops.clear();
 
+   // Size the applied operation list for the real operations up front so that it is not reallocated, and every
+   // operation_history_object copied, as the block's operations are pushed.  Virtual operations may still grow it.
+   size_t op_count = 0;
+   for( const auto& trx : next_block.transactions )
+      op_count += trx.operations.size();
+   _applied_ops.reserve( op_count );
+
    FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
 
    const witness_object& signing_witness = validate_block_header(skip, next_block);
@@ -399,6 +670,10 @@ void database::_apply_block( const signed_block& next_block )
    _current_block_num    = next_block.block_num();
    _current_trx_in_block = 0;
 
+   // Validation and ids do not depend on chain state, so compute them for the whole block up front; this is the
+   // part that runs on the prevalidation threads.
+   const auto precomputed = _prevalidator.run( next_block.transactions, !(skip & skip_transaction_dupe_check) );
+
    for( const auto& trx : next_block.transactions )
    {
       /* We do not need to push the undo state for each transaction
@@ -407,13 +682,17 @@ void database::_apply_block( const signed_block& next_block )
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      apply_transaction( trx, skip | skip_transaction_signatures );
+      with_skip_flags( skip | skip_transaction_signatures, [&]()
+      {
+         _apply_transaction_operations<StaticSkip | skip_transaction_signatures>( trx, &precomputed[_current_trx_in_block] );
+      });
       ++_current_trx_in_block;
    }
 
    update_witness_schedule(next_block);
    update_global_dynamic_data(next_block);
    update_signing_witness(signing_witness, next_block);
+   update_last_irreversible_block();
 
    auto current_block_interval = global_props.parameters.block_interval;
 
@@ -429,8 +708,24 @@ void database::_apply_block( const signed_block& next_block )
    update_expired_feeds();
    update_withdraw_permissions();
 
+   // A block applied in a session of its own can be popped, and is cached when it is.  Its changes are captured
+   // before the observers run, since they run again when the block is redone from the cache.
+   const bool can_pop = _popped_block_cache_size > 0 && _undo_db.in_session();
+   popped_block applied;
+   if( can_pop && !applied_block.empty() )
+   {
+      _undo_db.capture( applied.changes );
+      applied.changes_captured = true;
+   }
+
    // notify observers that the block has been applied
    applied_block( next_block ); //emit
+   if( can_pop )
+   {
+      applied.applied_ops = std::move( _applied_ops );
+      applied.block_interval = current_block_interval;
+      remember_applied_block( dynamic_global_props.head_block_id, std::move( applied ) );
+   }
    _applied_ops.clear();
 
    notify_changed_objects();
@@ -438,6 +733,16 @@ void database::_apply_block( const signed_block& next_block )
    update_pending_block(next_block, current_block_interval);
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
+void database::_apply_block( const signed_block& next_block )
+{
+   // Replayed blocks take a specialization in which the checks in replay_skip_flags, and the lookups that only
+   // support them, are compiled out rather than tested per transaction.
+   if( (get_node_properties().skip_flags & replay_skip_flags) == replay_skip_flags )
+      _apply_block_impl<replay_skip_flags>( next_block );
+   else
+      _apply_block_impl<skip_nothing>( next_block );
+}
+
 void database::notify_changed_objects()
 {
    const auto& head_undo = _undo_db.head();
@@ -446,24 +751,31 @@ void database::notify_changed_objects()
    changed_objects(changed_ids);
 }
 
-processed_transaction database::apply_transaction(const signed_transaction& trx, uint32_t skip)
+processed_transaction database::_apply_transaction(const signed_transaction& trx, const precomputed_transaction* pre)
 {
-   processed_transaction result;
-   with_skip_flags(skip, [&]()
-   {
-      result = _apply_transaction(trx);
-   });
-   return result;
+   auto results = _apply_transaction_operations(trx, pre);
+   processed_transaction ptrx(trx);
+   ptrx.operation_results = std::move(results);
+   return ptrx;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+template<uint32_t StaticSkip>
+vector<operation_result> database::_apply_transaction_operations(const signed_transaction& trx,
+                                                                 const precomputed_transaction* pre)
 { try {
-   uint32_t skip = get_node_properties().skip_flags;
-   trx.validate();
-   auto& trx_idx = get_mutable_index_type<transaction_index>();
-   auto trx_id = trx.id();
-   FC_ASSERT( (skip & skip_transaction_dupe_check) ||
-              trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
+   const uint32_t skip = get_node_properties().skip_flags | StaticSkip;
+   if( pre && pre->validation_error )
+      std::rethrow_exception( pre->validation_error );
+   if( !pre )
+      trx.validate();
+
+   transaction_id_type trx_id;
+   if( !(skip & skip_transaction_dupe_check) )
+   {
+      trx_id = pre ? pre->id : trx.id();
+      const auto& trx_idx = get_index_type<transaction_index>().indices().get<by_trx_id>();
+      FC_ASSERT( trx_idx.find(trx_id) == trx_idx.end() );
+   }
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
@@ -504,21 +816,19 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    eval_state.operation_results.reserve(trx.operations.size());
 
    //Finally process the operations
-   processed_transaction ptrx(trx);
    _current_op_in_trx = 0;
-   for( const auto& op : ptrx.operations )
+   for( const auto& op : trx.operations )
    {
       eval_state.operation_results.emplace_back(apply_operation(eval_state, op));
       ++_current_op_in_trx;
    }
-   ptrx.operation_results = std::move(eval_state.operation_results);
 
    //Make sure the temp account has no non-zero balances
    const auto& index = get_index_type<account_balance_index>().indices().get<by_account>();
    auto range = index.equal_range(GRAPHENE_TEMP_ACCOUNT);
    std::for_each(range.first, range.second, [](const account_balance_object& b) { FC_ASSERT(b.balance == 0); });
 
-   return ptrx;
+   return std::move(eval_state.operation_results);
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
 operation_result database::apply_operation(transaction_evaluation_state& eval_state, const operation& op)
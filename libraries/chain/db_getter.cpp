@@ -58,6 +58,11 @@ block_id_type database::head_block_id()const
    return get( dynamic_global_property_id_type() ).head_block_id;
 }
 
+uint32_t database::last_irreversible_block_num()const
+{
+   return get( dynamic_global_property_id_type() ).last_irreversible_block_num;
+}
+
 decltype( chain_parameters::block_interval ) database::block_interval( )const
 {
    return get_global_properties().parameters.block_interval;
@@ -158,40 +158,52 @@ void database::initialize_indexes()
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index> >();
+   auto asset_idx = add_index< primary_index<asset_index> >();
+   _changed_bitassets = asset_idx->add_secondary_index<changed_bitasset_index>();
    add_index< primary_index<force_settlement_index> >();
 
    auto acnt_index = add_index< primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
    acnt_index->add_secondary_index<account_referrer_index>();
+   _vote_totals = acnt_index->add_secondary_index<vote_tally_index>();
 
    add_index< primary_index<committee_member_index> >();
    add_index< primary_index<witness_index> >();
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   auto limit_index = add_index< primary_index<limit_order_index > >();
+   _margin_call_triggers = limit_index->add_secondary_index<margin_call_trigger_index>();
+   _order_books = limit_index->add_secondary_index<order_book_index>();
+   auto call_index = add_index< primary_index<call_order_index > >();
+   call_index->add_secondary_index<margin_call_trigger_index::observer>( *_margin_call_triggers );
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
 
    add_index< primary_index<withdraw_permission_index > >();
-   add_index< primary_index<vesting_balance_index> >();
+   auto vesting_index = add_index< primary_index<vesting_balance_index> >();
+   vesting_index->add_secondary_index<vote_tally_index::observer>( *_vote_totals );
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
 
    //Implementation object indexes
    add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
-   add_index< primary_index<asset_bitasset_data_index                     > >();
+   auto balance_index = add_index< primary_index<account_balance_index    > >();
+   balance_index->add_secondary_index<vote_tally_index::observer>( *_vote_totals );
+   auto bitasset_index = add_index< primary_index<asset_bitasset_data_index > >();
+   bitasset_index->add_secondary_index<margin_call_trigger_index::observer>( *_margin_call_triggers );
+   bitasset_index->add_secondary_index<changed_bitasset_index::observer>( *_changed_bitassets );
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<simple_index<account_statistics_object       >> >();
+   auto statistics_index = add_index< primary_index<simple_index<account_statistics_object>> >();
+   statistics_index->add_secondary_index<vote_tally_index::observer>( *_vote_totals );
+   _pending_fees = statistics_index->add_secondary_index<pending_fees_index>();
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<flat_index<  block_summary_object            >> >();
    add_index< primary_index<simple_index<witness_schedule_object         >> >();
 }
 
-void database::init_genesis(const genesis_state_type& genesis_state)
+void database::init_genesis(genesis_reader genesis)
 { try {
+   const genesis_state_type& genesis_state = genesis.header();
    FC_ASSERT( genesis_state.initial_timestamp != time_point_sec(), "Must initialize genesis timestamp." );
    FC_ASSERT( genesis_state.initial_timestamp.sec_since_epoch() % GRAPHENE_DEFAULT_BLOCK_INTERVAL == 0,
               "Genesis timestamp must be divisible by GRAPHENE_DEFAULT_BLOCK_INTERVAL." );
@@ -229,12 +241,12 @@ void database::init_genesis(const genesis_state_type& genesis_state)
          n.owner.weight_threshold = 1;
          n.active.weight_threshold = 1;
          n.name = "committee-account";
-         n.statistics = create<account_statistics_object>( [&](account_statistics_object& b){}).id;
+         n.statistics = create<account_statistics_object>( [&](account_statistics_object& b){ b.owner = n.id; }).id;
       });
    FC_ASSERT(committee_account.get_id() == GRAPHENE_COMMITTEE_ACCOUNT);
    FC_ASSERT(create<account_object>([this](account_object& a) {
        a.name = "witness-account";
-       a.statistics = create<account_statistics_object>([](account_statistics_object&){}).id;
+       a.statistics = create<account_statistics_object>([&a](account_statistics_object& s){ s.owner = a.id; }).id;
        a.owner.weight_threshold = 1;
        a.active.weight_threshold = 1;
        a.registrar = a.lifetime_referrer = a.referrer = GRAPHENE_WITNESS_ACCOUNT;
@@ -244,7 +256,7 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    }).get_id() == GRAPHENE_WITNESS_ACCOUNT);
    FC_ASSERT(create<account_object>([this](account_object& a) {
        a.name = "relaxed-committee-account";
-       a.statistics = create<account_statistics_object>([](account_statistics_object&){}).id;
+       a.statistics = create<account_statistics_object>([&a](account_statistics_object& s){ s.owner = a.id; }).id;
        a.owner.weight_threshold = 1;
        a.active.weight_threshold = 1;
        a.registrar = a.lifetime_referrer = a.referrer = GRAPHENE_RELAXED_COMMITTEE_ACCOUNT;
@@ -254,7 +266,7 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    }).get_id() == GRAPHENE_RELAXED_COMMITTEE_ACCOUNT);
    FC_ASSERT(create<account_object>([this](account_object& a) {
        a.name = "null-account";
-       a.statistics = create<account_statistics_object>([](account_statistics_object&){}).id;
+       a.statistics = create<account_statistics_object>([&a](account_statistics_object& s){ s.owner = a.id; }).id;
        a.owner.weight_threshold = 1;
        a.active.weight_threshold = 1;
        a.registrar = a.lifetime_referrer = a.referrer = GRAPHENE_NULL_ACCOUNT;
@@ -264,7 +276,7 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    }).get_id() == GRAPHENE_NULL_ACCOUNT);
    FC_ASSERT(create<account_object>([this](account_object& a) {
        a.name = "temp-account";
-       a.statistics = create<account_statistics_object>([](account_statistics_object&){}).id;
+       a.statistics = create<account_statistics_object>([&a](account_statistics_object& s){ s.owner = a.id; }).id;
        a.owner.weight_threshold = 0;
        a.active.weight_threshold = 0;
        a.registrar = a.lifetime_referrer = a.referrer = GRAPHENE_TEMP_ACCOUNT;
@@ -298,7 +310,6 @@ void database::init_genesis(const genesis_state_type& genesis_state)
 
    // Create global properties
    create<global_property_object>([&](global_property_object& p) {
-       p.chain_id = fc::digest(genesis_state);
        p.parameters = genesis_state.initial_parameters;
        // Set fees to zero initially, so that genesis initialization needs not pay them
        // We'll fix it at the end of the function
@@ -311,33 +322,67 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    });
    create<block_summary_object>([&](block_summary_object&) {});
 
-   // Create initial accounts
-   for( const auto& account : genesis_state.initial_accounts )
-   {
-      account_create_operation cop;
-      cop.name = account.name;
-      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
-      cop.owner = authority(1, account.owner_key, 1);
-      if( account.active_key == public_key_type() )
-      {
-         cop.active = cop.owner;
-         cop.options.memo_key = account.owner_key;
-      }
-      else
-      {
-         cop.active = authority(1, account.active_key, 1);
-         cop.options.memo_key = account.active_key;
-      }
-      account_id_type account_id(apply_operation(genesis_eval_state, cop).get<object_id_type>());
+   // Create initial accounts.  A genesis state may hold millions of them, so rather than applying an
+   // account_create_operation for each, the accounts are built exactly as the evaluators would build them and the
+   // indexes are filled in bulk load mode, which builds the secondary indexes in one pass when it ends.
+   begin_bulk_load();
+   get_mutable_index<account_object>().reserve( genesis.account_count() );
+   get_mutable_index<account_statistics_object>().reserve( genesis.account_count() );
+   genesis.read_accounts( [&]( const vector<genesis_state_type::initial_account_type>& initial_accounts ) {
+      const auto& params = get_global_properties().parameters;
+      const account_id_type lifetime_referrer = account_id_type()(*this).lifetime_referrer;
+      const account_id_type first_account_id = get_index_type<account_index>().get_next_id();
+
+      // the database is only read here, so the objects are prepared on the worker threads
+      vector<account_object> prepared( initial_accounts.size() );
+      _prevalidator.workers().run_sharded( prepared.size(), [&]( size_t, size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+         {
+            const auto& account = initial_accounts[i];
+            account_object& a = prepared[i];
+            a.registrar = GRAPHENE_TEMP_ACCOUNT;
+            a.lifetime_referrer = lifetime_referrer;
+            a.network_fee_percentage = params.network_percent_of_fee;
+            a.lifetime_referrer_fee_percentage = params.lifetime_referrer_percent_of_fee;
+            a.name = account.name;
+            a.owner = authority(1, account.owner_key, 1);
+            if( account.active_key == public_key_type() )
+            {
+               a.active = a.owner;
+               a.options.memo_key = account.owner_key;
+            }
+            else
+            {
+               a.active = authority(1, account.active_key, 1);
+               a.options.memo_key = account.active_key;
+            }
+
+            if( account.is_lifetime_member )
+            {
+               a.membership_expiration_date = time_point_sec::maximum();
+               a.referrer = a.registrar = a.lifetime_referrer = account_id_type( first_account_id.instance.value + i );
+               a.lifetime_referrer_fee_percentage = GRAPHENE_100_PERCENT - a.network_fee_percentage;
+            }
+         }
+      });
 
-      if( account.is_lifetime_member )
+      for( account_object& account : prepared )
       {
-          account_upgrade_operation op;
-          op.account_to_upgrade = account_id;
-          op.upgrade_to_lifetime_member = true;
-          apply_operation(genesis_eval_state, op);
+         const auto& stats = create<account_statistics_object>( [&]( account_statistics_object& s ) {
+            s.owner = get_index_type<account_index>().get_next_id();
+         });
+         create<account_object>( [&]( account_object& a ) {
+            const auto id = a.id;
+            a = std::move( account );
+            a.id = id;
+            a.statistics = stats.id;
+         });
       }
-   }
+
+      modify( get_dynamic_global_properties(), [&prepared]( dynamic_global_property_object& p ) {
+         p.accounts_registered_this_interval += prepared.size();
+      });
+   });
 
    // Helper function to get account ID by name
    const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_name>();
@@ -360,101 +405,111 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    };
 
    // Create initial assets
-   for( const genesis_state_type::initial_asset_type& asset : genesis_state.initial_assets )
-   {
-      asset_dynamic_data_id_type dynamic_data_id;
-      optional<asset_bitasset_data_id_type> bitasset_data_id;
-      if( asset.bitasset_opts.valid() )
+   genesis.read_assets( [&]( const vector<genesis_state_type::initial_asset_type>& initial_assets ) {
+      for( const genesis_state_type::initial_asset_type& asset : initial_assets )
       {
-         share_type total_allocated;
-         asset_id_type new_asset_id = get_index_type<asset_index>().get_next_id();
-         asset_id_type collateral_asset_id = get_asset_id(asset.bitasset_opts->backing_asset_symbol);
-
-         int collateral_holder_number = 0;
-         for( const auto& collateral_rec : asset.bitasset_opts->collateral_records )
+         asset_dynamic_data_id_type dynamic_data_id;
+         optional<asset_bitasset_data_id_type> bitasset_data_id;
+         if( asset.bitasset_opts.valid() )
          {
-            account_create_operation cop;
-            cop.name = asset.symbol + "-collateral-holder-" + std::to_string(collateral_holder_number);
-            boost::algorithm::to_lower(cop.name);
-            cop.registrar = GRAPHENE_TEMP_ACCOUNT;
-            cop.owner = authority(1, collateral_rec.owner, 1);
-            cop.active = cop.owner;
-            account_id_type owner_account_id = apply_operation(genesis_eval_state, cop).get<object_id_type>();
-
-            create<call_order_object>([&](call_order_object& c) {
-               c.borrower = owner_account_id;
-               c.collateral = collateral_rec.collateral;
-               c.debt = collateral_rec.debt;
-               c.call_price = price::call_price(chain::asset(c.debt, new_asset_id),
-                                                chain::asset(c.collateral, collateral_asset_id),
-                                                asset.bitasset_opts->maintenance_collateral_ratio);
-            });
-
-            total_allocated += collateral_rec.debt;
-         }
-
-         bitasset_data_id = create<asset_bitasset_data_object>([&](asset_bitasset_data_object& b) {
-            b.options.feed_lifetime_sec = asset.bitasset_opts->feed_lifetime_sec;
-            b.options.minimum_feeds = asset.bitasset_opts->minimum_feeds;
-            b.options.force_settlement_delay_sec = asset.bitasset_opts->force_settlement_delay_sec;
-            b.options.force_settlement_offset_percent = asset.bitasset_opts->force_settlement_offset_percent;
-            b.options.maximum_force_settlement_volume = asset.bitasset_opts->maximum_force_settlement_volume;
-            b.options.short_backing_asset = get_asset_id(asset.bitasset_opts->backing_asset_symbol);
-         }).id;
-
-         dynamic_data_id = create<asset_dynamic_data_object>([&](asset_dynamic_data_object& d) {
-            d.current_supply = total_allocated;
-            d.accumulated_fees = asset.initial_accumulated_fees;
-         }).id;
-      } else
-         dynamic_data_id = create<asset_dynamic_data_object>([&](asset_dynamic_data_object& d) {
-            d.accumulated_fees = asset.initial_accumulated_fees;
-         }).id;
-
-      create<asset_object>([&](asset_object& a) {
-         a.symbol = asset.symbol;
-         a.options.description = asset.description;
-         a.precision = asset.precision;
-         a.issuer = get_account_id(asset.issuer_name);
-         a.options.max_supply = asset.max_supply;
-         a.options.market_fee_percent = asset.market_fee_percent;
-         a.options.max_market_fee = asset.max_market_fee;
-         a.options.issuer_permissions = asset.issuer_permissions;
-         a.options.flags = asset.flags;
-
-         a.dynamic_asset_data_id = dynamic_data_id;
-         a.bitasset_data_id = bitasset_data_id;
-      });
-   }
+            share_type total_allocated;
+            asset_id_type new_asset_id = get_index_type<asset_index>().get_next_id();
+            asset_id_type collateral_asset_id = get_asset_id(asset.bitasset_opts->backing_asset_symbol);
+
+            int collateral_holder_number = 0;
+            for( const auto& collateral_rec : asset.bitasset_opts->collateral_records )
+            {
+               account_create_operation cop;
+               cop.name = asset.symbol + "-collateral-holder-" + std::to_string(collateral_holder_number);
+               boost::algorithm::to_lower(cop.name);
+               cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+               cop.owner = authority(1, collateral_rec.owner, 1);
+               cop.active = cop.owner;
+               account_id_type owner_account_id = apply_operation(genesis_eval_state, cop).get<object_id_type>();
+
+               create<call_order_object>([&](call_order_object& c) {
+                  c.borrower = owner_account_id;
+                  c.collateral = collateral_rec.collateral;
+                  c.debt = collateral_rec.debt;
+                  c.call_price = price::call_price(chain::asset(c.debt, new_asset_id),
+                                                   chain::asset(c.collateral, collateral_asset_id),
+                                                   asset.bitasset_opts->maintenance_collateral_ratio);
+               });
+
+               total_allocated += collateral_rec.debt;
+            }
+
+            bitasset_data_id = create<asset_bitasset_data_object>([&](asset_bitasset_data_object& b) {
+               b.asset_id = new_asset_id;
+               b.options.feed_lifetime_sec = asset.bitasset_opts->feed_lifetime_sec;
+               b.options.minimum_feeds = asset.bitasset_opts->minimum_feeds;
+               b.options.force_settlement_delay_sec = asset.bitasset_opts->force_settlement_delay_sec;
+               b.options.force_settlement_offset_percent = asset.bitasset_opts->force_settlement_offset_percent;
+               b.options.maximum_force_settlement_volume = asset.bitasset_opts->maximum_force_settlement_volume;
+               b.options.short_backing_asset = get_asset_id(asset.bitasset_opts->backing_asset_symbol);
+            }).id;
+
+            dynamic_data_id = create<asset_dynamic_data_object>([&](asset_dynamic_data_object& d) {
+               d.current_supply = total_allocated;
+               d.accumulated_fees = asset.initial_accumulated_fees;
+            }).id;
+         } else
+            dynamic_data_id = create<asset_dynamic_data_object>([&](asset_dynamic_data_object& d) {
+               d.accumulated_fees = asset.initial_accumulated_fees;
+            }).id;
+
+         create<asset_object>([&](asset_object& a) {
+            a.symbol = asset.symbol;
+            a.options.description = asset.description;
+            a.precision = asset.precision;
+            a.issuer = get_account_id(asset.issuer_name);
+            a.options.max_supply = asset.max_supply;
+            a.options.market_fee_percent = asset.market_fee_percent;
+            a.options.max_market_fee = asset.max_market_fee;
+            a.options.issuer_permissions = asset.issuer_permissions;
+            a.options.flags = asset.flags;
+
+            a.dynamic_asset_data_id = dynamic_data_id;
+            a.bitasset_data_id = bitasset_data_id;
+         });
+      }
+   });
 
    // Create initial balances
+   get_mutable_index<balance_object>().reserve( genesis.balance_count() + genesis.vesting_balance_count() );
    share_type total_allocation;
-   for( const auto& handout : genesis_state.initial_balances )
-   {
-      create<balance_object>([&handout,&assets_by_symbol,total_allocation](balance_object& b) {
-         b.balance = asset(handout.amount, assets_by_symbol.find(handout.asset_symbol)->get_id());
-         b.owner = handout.owner;
-      });
-      total_allocation += handout.amount;
-   }
+   genesis.read_balances( [&]( const vector<genesis_state_type::initial_balance_type>& initial_balances ) {
+      for( const auto& handout : initial_balances )
+      {
+         create<balance_object>([&handout,&assets_by_symbol,total_allocation](balance_object& b) {
+            b.balance = asset(handout.amount, assets_by_symbol.find(handout.asset_symbol)->get_id());
+            b.owner = handout.owner;
+         });
+         total_allocation += handout.amount;
+      }
+   });
 
    // Create initial vesting balances
-   for( const genesis_state_type::initial_vesting_balance_type& vest : genesis_state.initial_vesting_balances )
-   {
-      create<balance_object>([&](balance_object& b) {
-         b.owner = vest.owner;
-         b.balance = asset(vest.amount, assets_by_symbol.find(vest.asset_symbol)->get_id());
-
-         linear_vesting_policy policy;
-         policy.begin_timestamp = vest.begin_timestamp;
-         policy.vesting_cliff_seconds = 0;
-         policy.vesting_duration_seconds = vest.vesting_duration_seconds;
-         policy.begin_balance = vest.begin_balance;
-
-         b.vesting_policy = std::move(policy);
-      });
-      total_allocation += vest.amount;
-   }
+   genesis.read_vesting_balances(
+      [&]( const vector<genesis_state_type::initial_vesting_balance_type>& initial_vesting_balances ) {
+      for( const genesis_state_type::initial_vesting_balance_type& vest : initial_vesting_balances )
+      {
+         create<balance_object>([&](balance_object& b) {
+            b.owner = vest.owner;
+            b.balance = asset(vest.amount, assets_by_symbol.find(vest.asset_symbol)->get_id());
+
+            linear_vesting_policy policy;
+            policy.begin_timestamp = vest.begin_timestamp;
+            policy.vesting_cliff_seconds = 0;
+            policy.vesting_duration_seconds = vest.vesting_duration_seconds;
+            policy.begin_balance = vest.begin_balance;
+
+            b.vesting_policy = std::move(policy);
+         });
+         total_allocation += vest.amount;
+      }
+   });
+   end_bulk_load();
 
    // Set current supply based on allocations, if they happened
    if( total_allocation > 0 )
@@ -532,8 +587,9 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    });
    assert( wso.id == witness_schedule_id_type() );
 
-   // Enable fees
-   modify(get_global_properties(), [&genesis_state](global_property_object& p) {
+   // Enable fees, and set the chain id now that the whole genesis state has been read
+   modify(get_global_properties(), [&genesis_state,&genesis](global_property_object& p) {
+      p.chain_id = genesis.chain_id();
       p.parameters.current_fees = genesis_state.initial_parameters.current_fees;
    });
 
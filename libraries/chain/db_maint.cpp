@@ -55,12 +55,181 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
    return refs;
 }
 
-template<class... Types>
-void database::perform_account_maintenance(std::tuple<Types...> helpers)
+/// The core stake an account votes with: its balance, its cashback and what it has tied up in orders.
+static uint64_t get_voting_stake( const database& d, const account_object& stake_account )
 {
+   const auto& stats = stake_account.statistics(d);
+   return stats.total_core_in_orders.value
+         + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
+         + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
+}
+
+/// Counts the stake of one account towards the opinions it votes with
+static void tally_account( vote_totals& tally, const database& d, const global_property_object& props,
+                           const account_object& stake_account, uint64_t voting_stake )
+{
+   if( !props.parameters.count_non_member_votes && !stake_account.is_member(d.head_block_time()) )
+      return;
+
+   // There may be a difference between the account whose stake is voting and the one specifying opinions.
+   // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
+   // specifying the opinions.
+   const account_object& opinion_account =
+         (stake_account.options.voting_account ==
+          account_id_type())? stake_account
+                            : d.get(stake_account.options.voting_account);
+
+   tally.add(opinion_account.options.votes, opinion_account.options.num_witness,
+             opinion_account.options.num_committee, voting_stake);
+   tally.total_voting_stake += voting_stake;
+}
+
+/// Lays out vote totals the way update_active_witnesses and update_active_committee_members expect them
+static void fill_tally_buffers( const vote_totals& tally, const global_property_object& props,
+                                vector<uint64_t>& votes,
+                                vector<uint64_t>& witness_count_histogram,
+                                vector<uint64_t>& committee_count_histogram )
+{
+   votes.assign(props.next_available_vote_id, 0);
+   // if they somehow managed to specify an illegal offset, ignore it.
+   std::copy(tally.votes.begin(), tally.votes.begin() + std::min(tally.votes.size(), votes.size()), votes.begin());
+
+   witness_count_histogram.assign(props.parameters.maximum_witness_count / 2 + 1, 0);
+   for( const auto& item : tally.witness_count_stake )
+   {
+      if( item.first > props.parameters.maximum_witness_count )
+         continue;
+      uint16_t offset = std::min(size_t(item.first/2), witness_count_histogram.size() - 1);
+      // votes for a number greater than maximum_witness_count
+      // are turned into votes for maximum_witness_count.
+      //
+      // in particular, this takes care of the case where a
+      // member was voting for a high number, then the
+      // parameter was lowered.
+      witness_count_histogram[offset] += item.second;
+   }
+
+   committee_count_histogram.assign(props.parameters.maximum_committee_count / 2 + 1, 0);
+   for( const auto& item : tally.committee_count_stake )
+   {
+      if( item.first > props.parameters.maximum_committee_count )
+         continue;
+      uint16_t offset = std::min(size_t(item.first/2), committee_count_histogram.size() - 1);
+      // votes for a number greater than maximum_committee_count
+      // are turned into votes for maximum_committee_count.
+      //
+      // same rationale as for witnesses
+      committee_count_histogram[offset] += item.second;
+   }
+}
+
+void database::perform_account_maintenance(const global_property_object& props)
+{
+   // Membership lapses with time rather than through an object change, so the running totals can only stand in for
+   // the tally while every account's stake counts.
+   const bool use_running_totals = props.parameters.count_non_member_votes;
+#ifdef NDEBUG
+   const bool full_tally = !use_running_totals;
+#else
+   // debug builds check the running totals against a full tally
+   const bool full_tally = true;
+#endif
+
    const auto& idx = get_index_type<account_index>().indices();
-   for( const account_object& a : idx )
-      detail::for_each(helpers, a, detail::gen_seq<sizeof...(Types)>());
+   const worker_pool& workers = _prevalidator.workers();
+   vector<const account_object*> accounts;
+   vector<uint64_t> stakes;
+   if( full_tally )
+   {
+      accounts.reserve(idx.size());
+      for( const account_object& a : idx )
+         accounts.push_back(&a);
+
+      // Nothing is modified until the fee pass, so every stake can be read in parallel.  Stakes are kept by account
+      // instance.
+      stakes.resize(get_index_type<account_index>().get_next_id().instance());
+      workers.run_sharded(accounts.size(), [&]( size_t, size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            stakes[accounts[i]->id.instance()] = get_voting_stake(*this, *accounts[i]);
+      });
+   }
+
+   // Paying out fees deposits cashback with the referrers and the registrar, and historically each account's stake
+   // was read just before its own fees were processed, in a single pass over all accounts in id order.  Only the
+   // accounts with pending fees are visited here, so a full tally reads an account which was paid cashback by an
+   // earlier account again once every payer before it is done; the running totals record only the cashback paid to
+   // accounts after the one whose fees are being processed.  Either way the result is exactly that of the single
+   // pass.
+   vote_totals tally;
+   if( use_running_totals )
+   {
+      tally = _vote_totals->totals();
+      _vote_totals->begin_recording(tally);
+   }
+   // accounts paid cashback whose turn has not come yet
+   set<account_id_type> paid;
+   auto reread_paid = [&]( set<account_id_type>::iterator end ) {
+      for( auto itr = paid.begin(); itr != end; ++itr )
+         stakes[itr->instance.value] = get_voting_stake(*this, (*itr)(*this));
+      paid.erase(paid.begin(), end);
+   };
+
+   // processing fees removes the account from the set, so work from a copy
+   const vector<account_id_type> payers(_pending_fees->accounts_with_pending_fees.begin(),
+                                        _pending_fees->accounts_with_pending_fees.end());
+   for( account_id_type payer : payers )
+   {
+      const account_object& a = payer(*this);
+      if( full_tally )
+      {
+         reread_paid(paid.upper_bound(payer));
+         for( account_id_type recipient : {a.lifetime_referrer, a.referrer, a.registrar} )
+            if( payer < recipient )
+               paid.insert(recipient);
+      }
+      if( use_running_totals )
+         _vote_totals->record_changes_after(payer);
+      a.statistics(*this).process_fees(a, *this);
+   }
+   if( full_tally )
+      reread_paid(paid.end());
+   if( use_running_totals )
+      _vote_totals->end_recording();
+
+   if( full_tally )
+   {
+      // Each shard tallies into its own totals; the sums are the same whatever the split.
+      vector<vote_totals> shards(workers.max_shards());
+      workers.run_sharded(accounts.size(), [&]( size_t shard, size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            tally_account(shards[shard], *this, props, *accounts[i], stakes[accounts[i]->id.instance()]);
+      });
+      vote_totals full;
+      for( const vote_totals& shard : shards )
+         full.merge(shard);
+
+#ifndef NDEBUG
+      if( use_running_totals )
+      {
+         vector<uint64_t> votes, witness_count_histogram, committee_count_histogram;
+         fill_tally_buffers(full, props, votes, witness_count_histogram, committee_count_histogram);
+         fill_tally_buffers(tally, props, _vote_tally_buffer, _witness_count_histogram_buffer,
+                            _committee_count_histogram_buffer);
+         FC_ASSERT( votes == _vote_tally_buffer &&
+                    witness_count_histogram == _witness_count_histogram_buffer &&
+                    committee_count_histogram == _committee_count_histogram_buffer &&
+                    full.total_voting_stake == tally.total_voting_stake,
+                    "Running vote totals do not match a full tally",
+                    ("full", full.total_voting_stake)("running", tally.total_voting_stake) );
+      }
+#endif
+      if( !use_running_totals )
+         tally = std::move(full);
+   }
+
+   fill_tally_buffers(tally, props, _vote_tally_buffer, _witness_count_histogram_buffer,
+                      _committee_count_histogram_buffer);
+   _total_voting_stake = tally.total_voting_stake;
 }
 
 /// @brief A visitor for @ref worker_type which calls pay_worker on the worker within
@@ -368,83 +537,9 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 {
    const auto& gpo = get_global_properties();
 
-   struct vote_tally_helper {
-      database& d;
-      const global_property_object& props;
-
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
-      {
-         d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
-         d._committee_count_histogram_buffer.resize(props.parameters.maximum_committee_count / 2 + 1);
-         d._total_voting_stake = 0;
-      }
-
-      void operator()(const account_object& stake_account) {
-         if( props.parameters.count_non_member_votes || stake_account.is_member(d.head_block_time()) )
-         {
-            // There may be a difference between the account whose stake is voting and the one specifying opinions.
-            // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
-            // specifying the opinions.
-            const account_object& opinion_account =
-                  (stake_account.options.voting_account ==
-                   account_id_type())? stake_account
-                                     : d.get(stake_account.options.voting_account);
-
-            const auto& stats = stake_account.statistics(d);
-            uint64_t voting_stake = stats.total_core_in_orders.value
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
-                  + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
-
-            for( vote_id_type id : opinion_account.options.votes )
-            {
-               uint32_t offset = id.instance();
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
-            }
-
-            if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_witness_count
-               // are turned into votes for maximum_witness_count.
-               //
-               // in particular, this takes care of the case where a
-               // member was voting for a high number, then the
-               // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
-            }
-            if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_committee_count
-               // are turned into votes for maximum_committee_count.
-               //
-               // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
-            }
-
-            d._total_voting_stake += voting_stake;
-         }
-      }
-   } tally_helper(*this, gpo);
-   struct process_fees_helper {
-      database& d;
-      const global_property_object& props;
-
-      process_fees_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo) {}
+   auto maintenance_start = fc::time_point::now();
 
-      void operator()(const account_object& a) {
-         a.statistics(d).process_fees(a, d);
-      }
-   } fee_helper(*this, gpo);
-
-   perform_account_maintenance(std::tie(tally_helper, fee_helper));
+   perform_account_maintenance(gpo);
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -509,12 +604,17 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    });
 
    // Reset all BitAsset force settlement volumes to zero
-   for( const asset_bitasset_data_object* d : get_index_type<asset_bitasset_data_index>() )
-      modify(*d, [](asset_bitasset_data_object& d) { d.force_settled_volume = 0; });
+   for( const asset_bitasset_data_object& d : get_index_type<asset_bitasset_data_index>().indices() )
+      if( d.force_settled_volume != 0 )
+         modify(d, [](asset_bitasset_data_object& d) { d.force_settled_volume = 0; });
 
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
    process_budget();
+
+   _last_maintenance_duration = fc::time_point::now() - maintenance_start;
+   ilog( "Chain maintenance at block ${n} took ${t} ms",
+         ("n", next_block.block_num())("t", _last_maintenance_duration.count() / 1000) );
 }
 
 } }
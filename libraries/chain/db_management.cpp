@@ -18,13 +18,58 @@
 
 #include <graphene/chain/database.hpp>
 
+#include <graphene/chain/block_prefetcher.hpp>
 #include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <fc/io/json.hpp>
+
+#include <cstdlib>
+#include <fcntl.h>
 #include <functional>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace graphene { namespace chain {
 
+/** the tag of a state checkpoint, which is written last and so marks the checkpoint complete */
+struct state_checkpoint
+{
+   uint32_t       block_num = 0;
+   block_id_type  block_id;
+};
+
+} }
+FC_REFLECT( graphene::chain::state_checkpoint, (block_num)(block_id) )
+
+namespace graphene { namespace chain {
+
+/** makes sure a file written through the operating system's cache reaches the disk */
+static void sync_file( const fc::path& p )
+{
+#ifdef _WIN32
+   int fd = _wopen( p.generic_wstring().c_str(), _O_RDWR | _O_BINARY );
+   if( fd >= 0 ) { _commit( fd ); _close( fd ); }
+#else
+   int fd = ::open( p.generic_string().c_str(), O_RDONLY );
+   if( fd >= 0 ) { ::fsync( fd ); ::close( fd ); }
+#endif
+}
+
+/** calls f for each index file under the object_database directory of dir, with its path relative to dir */
+template<typename F>
+static void for_each_state_file( const fc::path& dir, F&& f )
+{
+   const fc::path state_dir = dir / "object_database";
+   for( fc::directory_iterator space( state_dir ); space != fc::directory_iterator(); ++space )
+      for( fc::directory_iterator file( *space ); file != fc::directory_iterator(); ++file )
+         f( fc::path( "object_database" ) / (*space).filename() / (*file).filename() );
+}
+
 database::database()
 {
    initialize_indexes();
@@ -36,7 +81,7 @@ database::~database(){
       _pending_block_session->commit();
 }
 
-void database::reindex(fc::path data_dir, const genesis_state_type& initial_allocation)
+void database::reindex(fc::path data_dir, const genesis_reader& initial_allocation)
 { try {
    wipe(data_dir, false);
    open(data_dir, [&initial_allocation]{return initial_allocation;});
@@ -46,29 +91,154 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
    if( !last_block ) return;
 
    const auto last_block_num = last_block->block_num();
+   FC_ASSERT( _block_id_to_block.first_block_num() == 1,
+              "The block log has been pruned to the blocks from ${first} on, so the chain cannot be replayed from it",
+              ("first", _block_id_to_block.first_block_num()) );
 
    // TODO: disable undo tracking during reindex, this currently causes crashes in the benchmark test
    //_undo_db.disable();
-   for( uint32_t i = 1; i <= last_block_num; ++i )
-   {
-      apply_block(*_block_id_to_block.fetch_by_number(i), skip_witness_signature |
-                                skip_transaction_signatures |
-                                skip_transaction_dupe_check |
-                                skip_tapos_check |
-                                skip_authority_check);
-   }
+   replay_blocks( 1, last_block_num );
    //_undo_db.enable();
    auto end = fc::time_point::now();
    wdump( ((end-start).count()/1000000.0) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::reindex_from_checkpoint(fc::path data_dir, const genesis_reader& initial_allocation)
+{ try {
+   // newest first
+   std::map<uint32_t, fc::path, std::greater<uint32_t>> checkpoints;
+   if( fc::exists( data_dir / "checkpoints" ) )
+      for( fc::directory_iterator itr( data_dir / "checkpoints" ); itr != fc::directory_iterator(); ++itr )
+         if( fc::exists( *itr / "checkpoint" ) )
+            checkpoints[ std::strtoul( (*itr).filename().generic_string().c_str(), nullptr, 10 ) ] = *itr;
+
+   for( const auto& item : checkpoints )
+   {
+      try {
+         auto start = fc::time_point::now();
+         auto tag = fc::json::from_file( item.second / "checkpoint" ).as<state_checkpoint>();
+
+         wipe(data_dir, false);
+         for_each_state_file( item.second, [&]( const fc::path& file ) {
+            fc::create_directories( (data_dir / file).parent_path() );
+            fc::copy( item.second / file, data_dir / file );
+         });
+         open(data_dir, [&initial_allocation]{return initial_allocation;});
+         FC_ASSERT( head_block_num() == tag.block_num && head_block_id() == tag.block_id,
+                    "The state in the checkpoint is not at its tagged block" );
+         FC_ASSERT( _block_id_to_block.fetch_block_id( tag.block_num ) == tag.block_id,
+                    "The checkpoint is not on the chain in the block log" );
+         ilog( "Loaded the state checkpoint at block ${n} in ${t} ms",
+               ("n", tag.block_num)("t", (fc::time_point::now() - start).count() / 1000) );
+
+         auto last_block_num = _block_id_to_block.last_block_num();
+         if( last_block_num > head_block_num() )
+            replay_blocks( head_block_num() + 1, last_block_num );
+         wlog( "Restored the state from the checkpoint at block ${n} and replayed ${r} blocks in ${t} sec",
+               ("n", tag.block_num)("r", head_block_num() - tag.block_num)
+               ("t", (fc::time_point::now() - start).count() / 1000000.0) );
+         return;
+      } catch( const fc::exception& e ) {
+         wlog( "Unable to restore the state checkpoint in ${d}: ${e}", ("d", item.second)("e", e.to_detail_string()) );
+      }
+   }
+
+   ilog( "No usable state checkpoint, replaying the whole block log" );
+   reindex( data_dir, initial_allocation );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+void database::replay_blocks( uint32_t first_num, uint32_t last_num )
+{
+   // enough blocks read ahead to ride out a slow read, in little memory
+   const uint32_t queue_depth = 256;
+   const auto report_interval = fc::seconds( 10 );
+
+   ilog( "Replaying blocks ${first} to ${last} with ${t} reader threads",
+         ("first", first_num)("last", last_num)("t", _replay_thread_count) );
+   block_prefetcher blocks( _block_id_to_block, first_num, last_num, _replay_thread_count,
+                            queue_depth, _replay_verify_signatures );
+   fc::microseconds apply_time;
+   const auto start = fc::time_point::now();
+   auto last_report = start;
+   uint32_t last_report_num = first_num - 1;
+
+   for( uint32_t i = first_num; i <= last_num; ++i )
+   {
+      auto next = blocks.next();
+      FC_ASSERT( next.valid() );
+      auto apply_start = fc::time_point::now();
+      if( next->signee )
+         FC_ASSERT( *next->signee == next->block.witness(*this).signing_key,
+                    "Block ${n} is not signed by its witness", ("n", i) );
+      apply_block( next->block, replay_skip_flags );
+      auto now = fc::time_point::now();
+      apply_time += now - apply_start;
+
+      if( now - last_report >= report_interval || i == last_num )
+      {
+         const auto elapsed = now - start;
+         const int64_t since_last = (now - last_report).count();
+         const uint64_t rate = since_last ? uint64_t( i - last_report_num ) * 1000000 / since_last : 0;
+         auto percent_of = [&]( fc::microseconds busy, uint32_t threads ) {
+            return elapsed.count() ? busy.count() * 100 / (elapsed.count() * threads) : 0;
+         };
+         ilog( "Replayed block ${i} of ${n}, ${r} blocks/sec, ${eta} sec remaining; "
+               "applying ${apply}%, waiting for blocks ${wait}%, reader threads busy ${read}%",
+               ("i", i)("n", last_num)("r", rate)("eta", rate ? (last_num - i) / rate : 0)
+               ("apply", percent_of( apply_time, 1 ))("wait", percent_of( blocks.wait_time(), 1 ))
+               ("read", blocks.thread_count() ? percent_of( blocks.read_time(), blocks.thread_count() ) : 0) );
+         last_report = now;
+         last_report_num = i;
+      }
+   }
+}
+
+void database::write_state_checkpoint()
+{ try {
+   FC_ASSERT( !_pending_block_session, "A state checkpoint cannot include pending transactions" );
+   auto start = fc::time_point::now();
+
+   // the blocks leading to the saved state must be in the block log to replay from it, as on close, and on disk
+   // before the checkpoint counts
+   store_blocks_through( head_block_num() );
+   _block_id_to_block.flush();
+
+   const fc::path checkpoints = get_data_dir() / "checkpoints";
+   const fc::path dir = checkpoints / fc::to_string( head_block_num() );
+   fc::remove_all( dir );
+   object_database::save( dir );
+   for_each_state_file( dir, [&]( const fc::path& file ) { sync_file( dir / file ); } );
+
+   state_checkpoint tag;
+   tag.block_num = head_block_num();
+   tag.block_id  = head_block_id();
+   fc::json::save_to_file( tag, dir / "checkpoint.tmp" );
+   sync_file( dir / "checkpoint.tmp" );
+   fc::rename( dir / "checkpoint.tmp", dir / "checkpoint" );
+
+   // only once the new checkpoint is complete are the older ones removed
+   vector<fc::path> old_checkpoints;
+   for( fc::directory_iterator itr( checkpoints ); itr != fc::directory_iterator(); ++itr )
+      if( *itr != dir )
+         old_checkpoints.push_back( *itr );
+   for( const auto& old : old_checkpoints )
+      fc::remove_all( old );
+
+   _last_checkpoint_block_num = head_block_num();
+   ilog( "Wrote a state checkpoint at block ${n} in ${t} ms",
+         ("n", head_block_num())("t", (fc::time_point::now() - start).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW() }
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
    close();
    object_database::wipe(data_dir);
    if( include_blocks )
+   {
       fc::remove_all( data_dir / "database" );
+      fc::remove_all( data_dir / "checkpoints" );
+   }
 }
 
 void database::close(uint32_t blocks_to_rewind)
@@ -78,6 +248,10 @@ void database::close(uint32_t blocks_to_rewind)
    for(uint32_t i = 0; i < blocks_to_rewind && head_block_num() > 0; ++i)
       pop_block();
 
+   // the state is saved at the head, so the blocks leading to it must be in the block log when it is reopened
+   if( _block_id_to_block.is_open() )
+      store_blocks_through( head_block_num() );
+
    object_database::flush();
    object_database::close();
 
@@ -85,6 +259,9 @@ void database::close(uint32_t blocks_to_rewind)
       _block_id_to_block.close();
 
    _fork_db.reset();
+   _popped_blocks.clear();
+   _popped_block_order.clear();
+   _applied_blocks.clear();
 }
 
 } }
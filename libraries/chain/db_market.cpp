@@ -115,38 +115,62 @@ void database::cancel_order( const limit_order_object& order, bool create_virtua
    remove(order);
 }
 
+void database::cancel_limit_orders( const vector<limit_order_id_type>& orders )
+{ try {
+   for( limit_order_id_type id : orders )
+   {
+      // the call orders checked after an earlier cancel may have filled this one
+      const limit_order_object* order = find( id );
+      if( order == nullptr )
+         continue;
+
+      const asset_id_type base_asset = order->sell_price.base.asset_id;
+      const asset_id_type quote_asset = order->sell_price.quote.asset_id;
+      limit_order_cancel_operation vop;
+      vop.fee_paying_account = order->seller;
+      vop.order = id;
+      auto op_id = push_applied_operation( std::move(vop) );
+
+      auto refunded = order->amount_for_sale();
+      cancel_order( *order, false );
+      set_applied_operation_result( op_id, refunded );
+
+      // as limit_order_cancel_evaluator does, so that calls fill against the orders still on the book in the same
+      // sequence as when each order was canceled by its own operation
+      check_call_orders( base_asset(*this) );
+      check_call_orders( quote_asset(*this) );
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
 bool database::apply_order(const limit_order_object& new_order_object, bool allow_black_swan)
 {
    auto order_id = new_order_object.id;
    const asset_object& sell_asset = get(new_order_object.amount_for_sale().asset_id);
    const asset_object& receive_asset = get(new_order_object.amount_to_receive().asset_id);
 
-   // Possible optimization: We only need to check calls if both are true:
-   //  - The new order is at the front of the book
-   //  - The new order is below the call limit price
+   // check_call_orders returns early, without touching the books, unless the new order is priced between the
+   // short squeeze price and the call limit; see margin_call_trigger_index.
    bool called_some = check_call_orders(sell_asset, allow_black_swan);
    called_some |= check_call_orders(receive_asset, allow_black_swan);
    if( called_some && !find_object(order_id) ) // then we were filled by call order
       return true;
 
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-
-   // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
-   // determine whether or not this order has "changed the book" in a way that requires us to
-   // check orders. For now I just lookup the lower bound and check for equality... this is log(n) vs
-   // constant time check. Potential optimization.
-
-   auto max_price = ~new_order_object.sell_price;
-   auto limit_itr = limit_price_idx.lower_bound(max_price.max());
-   auto limit_end = limit_price_idx.upper_bound(max_price);
+   // Walk the opposite side of the book from its best level down to the new order's price.  The book is
+   // re-read after every match because filled orders leave it; this visits orders in the same sequence
+   // as the by_price index of limit_order_index.
+   const order_book_index::price_key max_key( ~new_order_object.sell_price );
+   const asset_id_type sell_asset_id = sell_asset.id;
+   const asset_id_type receive_asset_id = receive_asset.id;
 
    bool finished = false;
-   while( !finished && limit_itr != limit_end )
+   while( !finished )
    {
-      auto old_limit_itr = limit_itr;
-      ++limit_itr;
+      const order_book_index::price_level* top = _order_books->best_level( receive_asset_id, sell_asset_id );
+      if( top == nullptr || top->key < max_key )
+         break;
+      const limit_order_object& old_order = *top->orders.front();
       // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-      finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      finished = (match(new_order_object, old_order, old_order.sell_price) != 2);
    }
 
    //Possible optimization: only check calls if the new order completely filled some old order
@@ -370,6 +394,7 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
     const asset_bitasset_data_object& bitasset = mia.bitasset_data(*this);
     if( bitasset.is_prediction_market ) return false;
     if( bitasset.current_feed.settlement_price.is_null() ) return false;
+    if( !_margin_call_triggers->might_call( mia.id ) ) return false;
 
     const call_order_index& call_index = get_index_type<call_order_index>();
     const auto& call_price_index = call_index.indices().get<by_price>();
@@ -388,6 +413,8 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
     auto limit_end = limit_price_index.upper_bound( min_price );
 
     if( limit_itr == limit_end ) {
+       // No limit order is priced high enough to fill a call; one would have to be placed above min_price.
+       _margin_call_triggers->set_idle( mia.id, min_price, optional<price>() );
        return false;
     }
 
@@ -395,6 +422,9 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
     auto call_end = call_price_index.upper_bound( price::max( bitasset.options.short_backing_asset, mia.id ) );
 
     bool filled_limit = false;
+    // A check which filled anything may have passed over a partly filled limit order (see filled_limit below), so only
+    // a check which filled nothing has seen the whole book and may mark the market idle.
+    bool filled_some = false;
 
     while( call_itr != call_end )
     {
@@ -407,12 +437,20 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
           match_price      = limit_itr->sell_price;
           usd_for_sale     = limit_itr->amount_for_sale();
        }
-       else return filled_limit;
+       else
+       {
+          if( !filled_some )
+             _margin_call_triggers->set_idle( mia.id, min_price, optional<price>() );
+          return filled_limit;
+       }
 
        match_price.validate();
 
        if( match_price > ~call_itr->call_price )
        {
+          // The book top is outside the call limit; until a better order arrives there is nothing to call.
+          if( !filled_some )
+             _margin_call_triggers->set_idle( mia.id, min_price, ~call_itr->call_price );
           return filled_limit;
        }
 
@@ -451,8 +489,12 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
 
        auto old_limit_itr = filled_limit ? limit_itr++ : limit_itr;
        fill_order(*old_limit_itr, order_pays, order_receives);
+       filled_some = true;
     } // whlie call_itr != call_end
 
+    // there were no call orders to begin with
+    if( !filled_some )
+       _margin_call_triggers->set_idle( mia.id, min_price, optional<price>() );
     return filled_limit;
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -59,16 +59,6 @@ void database::update_global_dynamic_data( const signed_block& b )
       dgp.time = b.timestamp;
       dgp.current_witness = b.witness;
    });
-
-   if( !(get_node_properties().skip_flags & skip_undo_history_check) )
-   {
-      GRAPHENE_ASSERT( _dgp.recently_missed_count < GRAPHENE_MAX_UNDO_HISTORY, undo_database_exception,
-                 "The database does not have enough undo history to support a blockchain with so many missed blocks. "
-                 "Please add a checkpoint if you would like to continue applying blocks beyond this point.",
-                 ("recently_missed",_dgp.recently_missed_count)("max_undo",GRAPHENE_MAX_UNDO_HISTORY) );
-   }
-
-   _undo_db.set_max_size( _dgp.recently_missed_count + GRAPHENE_MIN_UNDO_HISTORY );
 }
 
 void database::update_signing_witness(const witness_object& signing_witness, const signed_block& new_block)
@@ -89,16 +79,57 @@ void database::update_signing_witness(const witness_object& signing_witness, con
    {
       _wit.previous_secret = new_block.previous_secret;
       _wit.next_secret_hash = new_block.next_secret_hash;
+      _wit.last_confirmed_block_num = new_block.block_num();
    } );
 }
 
+void database::update_last_irreversible_block()
+{
+   const global_property_object& gpo = get_global_properties();
+   const dynamic_global_property_object& dpo = get_dynamic_global_properties();
+
+   vector<uint32_t> confirmed;
+   confirmed.reserve( gpo.active_witnesses.size() );
+   for( const witness_id_type& wid : gpo.active_witnesses )
+      confirmed.push_back( wid(*this).last_confirmed_block_num );
+
+   if( !confirmed.empty() )
+   {
+      // the block which at least GRAPHENE_IRREVERSIBLE_THRESHOLD of the active witnesses have confirmed
+      size_t offset = ( (GRAPHENE_100_PERCENT - GRAPHENE_IRREVERSIBLE_THRESHOLD) * confirmed.size() / GRAPHENE_100_PERCENT );
+      std::nth_element( confirmed.begin(), confirmed.begin() + offset, confirmed.end() );
+      uint32_t new_last_irreversible_block_num = confirmed[offset];
+
+      if( new_last_irreversible_block_num > dpo.last_irreversible_block_num )
+      {
+         modify( dpo, [&]( dynamic_global_property_object& _dpo )
+         {
+            _dpo.last_irreversible_block_num = new_last_irreversible_block_num;
+         } );
+      }
+   }
+
+   const uint32_t reversible_blocks = dpo.head_block_number - dpo.last_irreversible_block_num;
+   if( !(get_node_properties().skip_flags & skip_undo_history_check) )
+   {
+      GRAPHENE_ASSERT( reversible_blocks < GRAPHENE_MAX_UNDO_HISTORY, undo_database_exception,
+                 "The database does not have enough undo history to support a blockchain with so many reversible blocks. "
+                 "Please add a checkpoint if you would like to continue applying blocks beyond this point.",
+                 ("last_irreversible_block_num",dpo.last_irreversible_block_num)("head",dpo.head_block_number)
+                 ("max_undo",GRAPHENE_MAX_UNDO_HISTORY) );
+   }
+
+   // enough to pop back to the last irreversible block, and no further
+   _undo_db.set_max_size( reversible_blocks + 1 );
+}
+
 void database::update_pending_block(const signed_block& next_block, uint8_t current_block_interval)
 {
    _pending_block.timestamp = next_block.timestamp + current_block_interval;
    _pending_block.previous = next_block.id();
    auto old_pending_trx = std::move(_pending_block.transactions);
    _pending_block.transactions.clear();
-   for( auto old_trx : old_pending_trx )
+   for( const auto& old_trx : old_pending_trx )
       push_transaction( old_trx );
 }
 
@@ -117,9 +148,20 @@ void database::clear_expired_transactions()
 void database::clear_expired_proposals()
 {
    const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
-   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
+
+   // Collect the expired proposals up front rather than seeking the front of the index after every removal.
+   // An executed proposal may delete another one, so each is looked up again before it is processed.
+   vector<proposal_id_type> expired;
+   for( auto itr = proposal_expiration_index.begin();
+        itr != proposal_expiration_index.end() && itr->expiration_time <= head_block_time(); ++itr )
+      expired.push_back( itr->id );
+
+   for( proposal_id_type id : expired )
    {
-      const proposal_object& proposal = *proposal_expiration_index.begin();
+      const proposal_object* expired_proposal = find( id );
+      if( expired_proposal == nullptr )
+         continue;
+      const proposal_object& proposal = *expired_proposal;
       processed_transaction result;
       try {
          if( proposal.is_authorized_to_execute(*this) )
@@ -138,134 +180,179 @@ void database::clear_expired_proposals()
 
 void database::clear_expired_orders()
 {
-   with_skip_flags(
-      get_node_properties().skip_flags | skip_authority_check, [&](){
-         transaction_evaluation_state cancel_context(this);
+   //Cancel expired limit orders
+   auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
+   auto limit_end = limit_index.upper_bound( head_block_time() );
+   if( limit_index.begin() != limit_end )
+   {
+      vector<limit_order_id_type> expired;
+      for( auto itr = limit_index.begin(); itr != limit_end; ++itr )
+         expired.push_back( itr->id );
+      cancel_limit_orders( expired );
+   }
 
-         //Cancel expired limit orders
-         auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
-         while( !limit_index.empty() && limit_index.begin()->expiration <= head_block_time() )
-         {
-            limit_order_cancel_operation canceler;
-            const limit_order_object& order = *limit_index.begin();
-            canceler.fee_paying_account = order.seller;
-            canceler.order = order.id;
-            apply_operation(cancel_context, canceler);
-         }
-     });
 
+   //Process expired force settlement orders, one asset at a time
+   const auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
+   for( auto itr = settlement_index.begin(); itr != settlement_index.end(); )
+   {
+      asset_id_type current_asset = itr->settlement_asset_id();
+      execute_force_settlements( current_asset(*this) );
+      itr = settlement_index.upper_bound( current_asset );
+   }
+}
 
-   //Process expired force settlement orders
-   auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
-   if( !settlement_index.empty() )
+/**
+ *  Executes the force settlements of mia which have reached their settlement date, oldest first, until the maximum
+ *  force settlement volume for this maintenance interval is reached.  Each settlement is matched against the least
+ *  collateralized call orders.
+ */
+void database::execute_force_settlements( const asset_object& mia_object )
+{ try {
+   const auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
+   const auto& call_index = get_index_type<call_order_index>().indices().get<by_collateral>();
+   const asset_bitasset_data_object& mia = mia_object.bitasset_data(*this);
+   const price least_collateralized = price::min( mia.options.short_backing_asset, mia_object.get_id() );
+
+   optional<asset> max_settlement_volume;
+   asset settled = mia_object.amount(mia.force_settled_volume);
+
+   // Filling a call order outright leaves the next least collateralized one right after it in by_collateral; only a
+   // partial fill moves the call and forces a fresh lookup.
+   auto call_itr = call_index.end();
+   bool seek_call = true;
+
+   auto settle_itr = settlement_index.lower_bound( mia_object.get_id() );
+   auto settle_end = settlement_index.upper_bound( mia_object.get_id() );
+   while( settle_itr != settle_end )
    {
-      asset_id_type current_asset = settlement_index.begin()->settlement_asset_id();
-      asset max_settlement_volume;
-
-      auto next_asset = [&current_asset, &settlement_index] {
-         auto bound = settlement_index.upper_bound(current_asset);
-         if( bound == settlement_index.end() )
-            return false;
-         current_asset = bound->settlement_asset_id();
-         return true;
-      };
-
-      // At each iteration, we either consume the current order and remove it, or we move to the next asset
-      for( auto itr = settlement_index.lower_bound(current_asset);
-           itr != settlement_index.end();
-           itr = settlement_index.lower_bound(current_asset) )
+      // the order may be filled and removed below
+      const force_settlement_object& order = *settle_itr++;
+      auto order_id = order.id;
+
+      // Has this order not reached its settlement date?
+      if( order.settlement_date > head_block_time() )
+         break;
+      // Can we still settle in this asset?
+      if( mia.current_feed.settlement_price.is_null() )
       {
-         const force_settlement_object& order = *itr;
-         auto order_id = order.id;
-         current_asset = order.settlement_asset_id();
-         const asset_object& mia_object = get(current_asset);
-         const asset_bitasset_data_object mia = mia_object.bitasset_data(*this);
-
-         // Has this order not reached its settlement date?
-         if( order.settlement_date > head_block_time() )
-         {
-            if( next_asset() )
-               continue;
-            break;
-         }
-         // Can we still settle in this asset?
-         if( mia.current_feed.settlement_price.is_null() )
-         {
-            ilog("Canceling a force settlement in ${asset} because settlement price is null",
-                 ("asset", mia_object.symbol));
-            cancel_order(order);
-            continue;
-         }
-         if( max_settlement_volume.asset_id != current_asset )
-            max_settlement_volume = mia_object.amount(mia.max_force_settlement_volume(mia_object.dynamic_data(*this).current_supply));
-         if( mia.force_settled_volume >= max_settlement_volume.amount )
-         {
-            /*
-            ilog("Skipping force settlement in ${asset}; settled ${settled_volume} / ${max_volume}",
-                 ("asset", mia_object.symbol)("settlement_price_null",mia.current_feed.settlement_price.is_null())
-                 ("settled_volume", mia.force_settled_volume)("max_volume", max_settlement_volume));
-                 */
-            if( next_asset() )
-               continue;
-            break;
-         }
+         ilog("Canceling a force settlement in ${asset} because settlement price is null",
+              ("asset", mia_object.symbol));
+         cancel_order(order);
+         continue;
+      }
+      if( !max_settlement_volume )
+         max_settlement_volume = mia_object.amount(mia.max_force_settlement_volume(mia_object.dynamic_data(*this).current_supply));
+      if( settled >= *max_settlement_volume )
+         break;
 
-         auto& pays = order.balance;
-         auto receives = (order.balance * mia.current_feed.settlement_price);
-         receives.amount = (fc::uint128_t(receives.amount.value) *
-                            (GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent) / GRAPHENE_100_PERCENT).to_uint64();
-         assert(receives <= order.balance * mia.current_feed.settlement_price);
+      auto& pays = order.balance;
+      auto receives = (order.balance * mia.current_feed.settlement_price);
+      receives.amount = (fc::uint128_t(receives.amount.value) *
+                         (GRAPHENE_100_PERCENT - mia.options.force_settlement_offset_percent) / GRAPHENE_100_PERCENT).to_uint64();
+      assert(receives <= order.balance * mia.current_feed.settlement_price);
 
-         price settlement_price = pays / receives;
+      price settlement_price = pays / receives;
 
-         auto& call_index = get_index_type<call_order_index>().indices().get<by_collateral>();
-         asset settled = mia_object.amount(mia.force_settled_volume);
-         // Match against the least collateralized short until the settlement is finished or we reach max settlements
-         while( settled < max_settlement_volume && find_object(order_id) )
-         {
-            auto itr = call_index.lower_bound(boost::make_tuple(price::min(mia_object.bitasset_data(*this).options.short_backing_asset,
-                                                                           mia_object.get_id())));
-            // There should always be a call order, since asset exists!
-            assert(itr != call_index.end() && itr->debt_type() == mia_object.get_id());
-            asset max_settlement = max_settlement_volume - settled;
-            settled += match(*itr, order, settlement_price, max_settlement);
-         }
-         modify(mia, [settled](asset_bitasset_data_object& b) {
-            b.force_settled_volume = settled.amount;
-         });
+      // Match against the least collateralized short until the settlement is finished or we reach max settlements
+      while( settled < *max_settlement_volume && find_object(order_id) )
+      {
+         if( seek_call )
+            call_itr = call_index.lower_bound( boost::make_tuple( least_collateralized ) );
+         // There should always be a call order, since asset exists!
+         assert(call_itr != call_index.end() && call_itr->debt_type() == mia_object.get_id());
+
+         const call_order_object& call = *call_itr;
+         auto call_id = call.id;
+         auto next_call = std::next( call_itr );
+
+         asset max_settlement = *max_settlement_volume - settled;
+         settled += match(call, order, settlement_price, max_settlement);
+
+         seek_call = ( find_object(call_id) != nullptr );
+         if( !seek_call )
+            call_itr = next_call;
       }
    }
-}
+
+   // the volume is only read when the next settlement is considered, so it is written once per asset
+   if( settled.amount != mia.force_settled_volume )
+      modify(mia, [&settled](asset_bitasset_data_object& b) {
+         b.force_settled_volume = settled.amount;
+      });
+} FC_CAPTURE_AND_RETHROW( (mia_object.symbol) ) }
 
 void database::update_expired_feeds()
 {
-   auto& asset_idx = get_index_type<asset_index>().indices();
-   for( const asset_object& a : asset_idx )
+   if( head_block_time() < GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME )
    {
-      if( !a.is_market_issued() )
-         continue;
-
-      const asset_bitasset_data_object& b = a.bitasset_data(*this);
-      if( b.feed_is_expired(head_block_time()) )
+      // Replay the original rules exactly: every market-issued asset, every block, in asset id order
+      auto& asset_idx = get_index_type<asset_index>().indices();
+      for( const asset_object& a : asset_idx )
       {
-         modify(b, [this](asset_bitasset_data_object& a) {
-            a.update_median_feeds(head_block_time());
-         });
-         check_call_orders(b.current_feed.settlement_price.base.asset_id(*this));
+         if( !a.is_market_issued() )
+            continue;
+
+         const asset_bitasset_data_object& b = a.bitasset_data(*this);
+         if( b.feed_is_expired_before_hardfork(head_block_time()) )
+         {
+            modify(b, [this](asset_bitasset_data_object& a) {
+               a.update_median_feeds(head_block_time());
+            });
+            check_call_orders(b.current_feed.settlement_price.base.asset_id(*this));
+         }
+         if( !b.current_feed.core_exchange_rate.is_null() &&
+             a.options.core_exchange_rate != b.current_feed.core_exchange_rate )
+            modify(a, [&b](asset_object& a) {
+               a.options.core_exchange_rate = b.current_feed.core_exchange_rate;
+            });
       }
+      _changed_bitassets->changed_assets.clear();
+      return;
+   }
+
+   // Recalculating the median changes the expiration time, so collect the expired range before modifying any of it
+   const auto& feed_index = get_index_type<asset_bitasset_data_index>().indices().get<by_feed_expiration>();
+   vector<const asset_bitasset_data_object*> expired;
+   for( auto itr = feed_index.begin(); itr != feed_index.end() && itr->feed_is_expired(head_block_time()); ++itr )
+      expired.push_back( &*itr );
+
+   for( const asset_bitasset_data_object* b : expired )
+   {
+      modify(*b, [this](asset_bitasset_data_object& a) {
+         a.update_median_feeds(head_block_time());
+      });
+      check_call_orders(b->asset_id(*this));
+   }
+
+   // Only assets whose options or feeds changed since the last block can have a stale core exchange rate
+   flat_set<asset_id_type> changed;
+   std::swap( changed, _changed_bitassets->changed_assets );
+   for( asset_id_type id : changed )
+   {
+      const asset_object* a = find( id );
+      if( a == nullptr || !a->is_market_issued() )
+         continue;
+      const asset_bitasset_data_object& b = a->bitasset_data(*this);
       if( !b.current_feed.core_exchange_rate.is_null() &&
-          a.options.core_exchange_rate != b.current_feed.core_exchange_rate )
-         modify(a, [&b](asset_object& a) {
+          a->options.core_exchange_rate != b.current_feed.core_exchange_rate )
+         modify(*a, [&b](asset_object& a) {
             a.options.core_exchange_rate = b.current_feed.core_exchange_rate;
          });
    }
+   // the rates just written are in line with their feeds
+   _changed_bitassets->changed_assets.clear();
 }
 
 void database::update_withdraw_permissions()
 {
    auto& permit_index = get_index_type<withdraw_permission_index>().indices().get<by_expiration>();
-   while( !permit_index.empty() && permit_index.begin()->expiration <= head_block_time() )
-      remove(*permit_index.begin());
+   auto permit_end = permit_index.upper_bound( head_block_time() );
+   vector<const withdraw_permission_object*> expired;
+   for( auto itr = permit_index.begin(); itr != permit_end; ++itr )
+      expired.push_back( &*itr );
+   for( const withdraw_permission_object* permit : expired )
+      remove( *permit );
 }
 
 } }
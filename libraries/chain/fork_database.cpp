@@ -35,18 +35,18 @@ void fork_database::pop_block()
 
 void     fork_database::start_block( signed_block b )
 {
-   auto item = std::make_shared<fork_item>( std::move(b) );
+   auto item = std::make_shared<fork_item>( std::make_shared<const signed_block>( std::move(b) ) );
    _index.insert( item );
    _head = item;
 }
 
 shared_ptr<fork_item>  fork_database::push_block( const signed_block& b )
 {
-   auto item = std::make_shared<fork_item>( b );
+   auto item = std::make_shared<fork_item>( std::make_shared<const signed_block>( b ) );
 
-   if( _head && b.previous != block_id_type() )
+   if( _head && item->data->previous != block_id_type() )
    {
-      auto itr = _index.get<block_id>().find( b.previous );
+      auto itr = _index.get<block_id>().find( item->data->previous );
       FC_ASSERT( itr != _index.get<block_id>().end() );
       FC_ASSERT( !(*itr)->invalid );
       item->prev = *itr;
@@ -55,12 +55,15 @@ shared_ptr<fork_item>  fork_database::push_block( const signed_block& b )
    _index.insert( item );
    if( !_head ) _head = item;
    else if( item->num > _head->num )
-   {
       _head = item;
-      _index.get<block_num>().erase( _head->num - 1024 );
-   }
    return _head;
 }
+
+void fork_database::prune( uint32_t last_irreversible_block_num )
+{
+   auto& by_num = _index.get<block_num>();
+   by_num.erase( by_num.begin(), by_num.lower_bound( last_irreversible_block_num ) );
+}
 bool fork_database::is_known_block( const block_id_type& id )const
 {
    auto& index = _index.get<block_id>();
@@ -102,17 +105,17 @@ pair<fork_database::branch_type,fork_database::branch_type>
    auto second_branch = *second_branch_itr;
 
 
-   while( first_branch->data.block_num() > second_branch->data.block_num() )
+   while( first_branch->num > second_branch->num )
    {
       result.first.push_back( first_branch );
       first_branch = first_branch->prev.lock(); FC_ASSERT( first_branch );
    }
-   while( second_branch->data.block_num() > first_branch->data.block_num() )
+   while( second_branch->num > first_branch->num )
    {
       result.second.push_back( second_branch );
       second_branch = second_branch->prev.lock(); FC_ASSERT( second_branch );
    }
-   while( first_branch->data.previous != second_branch->data.previous )
+   while( first_branch->data->previous != second_branch->data->previous )
    {
       result.first.push_back( first_branch );
       result.second.push_back( second_branch );
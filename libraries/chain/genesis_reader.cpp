@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/genesis_reader.hpp>
+
+#include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+   /**
+    *  Walks the raw text of a JSON file, so that values can be located and copied out without parsing them.  Only
+    *  the structure is checked here; whatever is copied out is parsed by fc::json.
+    */
+   class json_cursor
+   {
+      public:
+         json_cursor( const fc::path& file, uint64_t offset )
+         :_in( file.generic_string(), std::ios::in | std::ios::binary ), _pos( offset )
+         {
+            FC_ASSERT( _in, "Unable to open ${f}", ("f", file) );
+            _in.seekg( offset );
+            _buf = _in.rdbuf();
+         }
+
+         uint64_t position()const { return _pos; }
+
+         /** @return the next character which is not whitespace, without consuming it */
+         char peek()
+         {
+            while( std::isspace( next_raw() ) )
+               get_raw();
+            return char( next_raw() );
+         }
+         char get()
+         {
+            char c = peek();
+            get_raw();
+            return c;
+         }
+         void expect( char c )
+         {
+            const auto pos = _pos;
+            FC_ASSERT( get() == c, "Expected '${c}' at offset ${p}", ("c", string(1, c))("p", pos) );
+         }
+
+         /** consumes the next value, appending its text to out unless out is null */
+         void copy_value( string* out )
+         {
+            const char c = peek();
+            if( c == '"' )
+            {
+               copy_string( out );
+               return;
+            }
+            if( c == '{' || c == '[' )
+            {
+               uint32_t depth = 0;
+               do {
+                  const char ch = char( next_raw() );
+                  if( ch == '"' )
+                  {
+                     copy_string( out );
+                     continue;
+                  }
+                  append( out, get_raw() );
+                  if( ch == '{' || ch == '[' )
+                     ++depth;
+                  else if( ch == '}' || ch == ']' )
+                     --depth;
+               } while( depth > 0 );
+               return;
+            }
+            // a number or a literal runs until the next delimiter
+            FC_ASSERT( c != ',' && c != ':' && c != '}' && c != ']', "Expected a value at offset ${p}", ("p", _pos) );
+            for( int ch = next_raw(); ch != ',' && ch != '}' && ch != ']' && !std::isspace( ch ); ch = next_raw() )
+               append( out, get_raw() );
+         }
+
+         /** consumes an array, returning the number of elements in it */
+         size_t skip_array()
+         {
+            expect( '[' );
+            size_t count = 0;
+            if( peek() == ']' )
+            {
+               get();
+               return count;
+            }
+            char c;
+            do {
+               copy_value( nullptr );
+               ++count;
+               c = get();
+            } while( c == ',' );
+            FC_ASSERT( c == ']', "Expected ',' or ']' before offset ${p}", ("p", _pos) );
+            return count;
+         }
+
+      private:
+         int next_raw()
+         {
+            const int c = _buf->sgetc();
+            FC_ASSERT( c != std::char_traits<char>::eof(), "Unexpected end of file at offset ${p}", ("p", _pos) );
+            return c;
+         }
+         char get_raw()
+         {
+            const char c = char( next_raw() );
+            _buf->sbumpc();
+            ++_pos;
+            return c;
+         }
+         static void append( string* out, char c )
+         {
+            if( out )
+               out->push_back( c );
+         }
+
+         void copy_string( string* out )
+         {
+            append( out, get_raw() );
+            while( true )
+            {
+               const char c = get_raw();
+               append( out, c );
+               if( c == '"' )
+                  return;
+               if( c == '\\' )
+                  append( out, get_raw() );
+            }
+         }
+
+         std::ifstream    _in;
+         std::streambuf*  _buf = nullptr;
+         uint64_t         _pos = 0;
+   };
+
+   const char* const array_names[] = { "initial_accounts", "initial_assets", "initial_balances",
+                                       "initial_vesting_balances" };
+
+} // anonymous namespace
+
+genesis_reader::genesis_reader( const genesis_state_type& genesis )
+:_genesis( &genesis, []( const genesis_state_type* ){} ), _header( _genesis )
+{
+   count_genesis_arrays();
+}
+
+genesis_reader::genesis_reader( genesis_state_type&& genesis )
+:_genesis( std::make_shared<genesis_state_type>( std::move(genesis) ) ), _header( _genesis )
+{
+   count_genesis_arrays();
+}
+
+void genesis_reader::count_genesis_arrays()
+{
+   _arrays[accounts].count = _genesis->initial_accounts.size();
+   _arrays[assets].count = _genesis->initial_assets.size();
+   _arrays[balances].count = _genesis->initial_balances.size();
+   _arrays[vesting_balances].count = _genesis->initial_vesting_balances.size();
+}
+
+genesis_reader::genesis_reader( const fc::path& json_file, size_t batch_size )
+:_json_file( json_file ), _batch_size( batch_size )
+{
+   FC_ASSERT( batch_size > 0 );
+   index_json_file();
+}
+
+void genesis_reader::index_json_file()
+{ try {
+   json_cursor in( _json_file, 0 );
+   string header = "{";
+   in.expect( '{' );
+   char c = in.peek();
+   if( c == '}' )
+      in.get();
+   else do {
+      string key_json;
+      in.copy_value( &key_json );
+      const string key = fc::json::from_string( key_json ).as_string();
+      in.expect( ':' );
+
+      auto name = std::find( std::begin(array_names), std::end(array_names), key );
+      if( name != std::end(array_names) )
+      {
+         array_location& location = _arrays[name - std::begin(array_names)];
+         in.peek();
+         location.offset = in.position();
+         location.count = in.skip_array();
+      }
+      else
+      {
+         if( header.size() > 1 )
+            header += ',';
+         header += key_json;
+         header += ':';
+         in.copy_value( &header );
+      }
+      c = in.get();
+   } while( c == ',' );
+   FC_ASSERT( c == '}', "Expected ',' or '}' before offset ${p}", ("p", in.position()) );
+   header += '}';
+
+   // the arrays are absent from the header, so they are left empty
+   _header = std::make_shared<genesis_state_type>( fc::json::from_string( header ).as<genesis_state_type>() );
+   ilog( "Indexed genesis state in ${f}: ${a} accounts, ${s} assets, ${b} balances, ${v} vesting balances",
+         ("f", _json_file)("a", account_count())("s", asset_count())("b", balance_count())
+         ("v", vesting_balance_count()) );
+} FC_CAPTURE_AND_RETHROW( (_json_file) ) }
+
+template<typename T>
+void genesis_reader::read_array( array_type which, const vector<T> genesis_state_type::* member,
+                                 const batch_handler<T>& handler )
+{ try {
+   FC_ASSERT( which == accounts || _arrays_read == which,
+              "The arrays of a genesis state must be read in order", ("array", array_names[which]) );
+   _arrays_read = which;
+
+   if( _genesis )
+   {
+      const vector<T>& records = (*_genesis).*member;
+      if( !records.empty() )
+         handler( records );
+      ++_arrays_read;
+      return;
+   }
+
+   if( which == accounts )
+   {
+      // the fields of the genesis state are hashed in declaration order
+      _chain_id_encoder = std::make_shared<fc::sha256::encoder>();
+      fc::raw::pack( *_chain_id_encoder, _header->initial_timestamp );
+      fc::raw::pack( *_chain_id_encoder, _header->initial_parameters );
+   }
+
+   const array_location& location = _arrays[which];
+   fc::raw::pack( *_chain_id_encoder, fc::unsigned_int( location.count ) );
+   if( location.count > 0 )
+   {
+      json_cursor in( _json_file, location.offset );
+      vector<T> batch;
+      batch.reserve( std::min( location.count, _batch_size ) );
+      in.expect( '[' );
+      string text;
+      for( size_t i = 0; i < location.count; ++i )
+      {
+         if( i > 0 )
+            in.expect( ',' );
+         text.clear();
+         in.copy_value( &text );
+         batch.push_back( fc::json::from_string( text ).as<T>() );
+         fc::raw::pack( *_chain_id_encoder, batch.back() );
+         if( batch.size() == _batch_size )
+         {
+            handler( batch );
+            batch.clear();
+         }
+      }
+      if( !batch.empty() )
+         handler( batch );
+   }
+   ++_arrays_read;
+
+   if( _arrays_read == array_count )
+   {
+      fc::raw::pack( *_chain_id_encoder, _header->initial_active_witnesses );
+      fc::raw::pack( *_chain_id_encoder, _header->initial_witness_candidates );
+      fc::raw::pack( *_chain_id_encoder, _header->initial_committee_candidates );
+      fc::raw::pack( *_chain_id_encoder, _header->initial_worker_candidates );
+      _chain_id = _chain_id_encoder->result();
+      _chain_id_encoder.reset();
+   }
+} FC_CAPTURE_AND_RETHROW( (_json_file)(which) ) }
+
+void genesis_reader::read_accounts( const batch_handler<genesis_state_type::initial_account_type>& handler )
+{
+   read_array( accounts, &genesis_state_type::initial_accounts, handler );
+}
+
+void genesis_reader::read_assets( const batch_handler<genesis_state_type::initial_asset_type>& handler )
+{
+   read_array( assets, &genesis_state_type::initial_assets, handler );
+}
+
+void genesis_reader::read_balances( const batch_handler<genesis_state_type::initial_balance_type>& handler )
+{
+   read_array( balances, &genesis_state_type::initial_balances, handler );
+}
+
+void genesis_reader::read_vesting_balances(
+   const batch_handler<genesis_state_type::initial_vesting_balance_type>& handler )
+{
+   read_array( vesting_balances, &genesis_state_type::initial_vesting_balances, handler );
+}
+
+fc::sha256 genesis_reader::chain_id()const
+{
+   if( _genesis )
+      return fc::digest( *_genesis );
+   FC_ASSERT( _arrays_read == array_count, "The chain id is known once every array has been read" );
+   return _chain_id;
+}
+
+} } // graphene::chain
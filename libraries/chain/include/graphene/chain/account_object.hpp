@@ -18,8 +18,11 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
+#include <memory>
+
 namespace graphene { namespace chain {
    class database;
 
@@ -38,6 +41,8 @@ namespace graphene { namespace chain {
          static const uint8_t space_id = implementation_ids;
          static const uint8_t type_id  = impl_account_statistics_object_type;
 
+         account_id_type  owner;
+
          /**
           * Keep the most recent operation as a root pointer to a linked list of the transaction history. This field is
           * not required by core validation and could in theory be made an annotation on the account object, but
@@ -239,16 +244,34 @@ namespace graphene { namespace chain {
    class account_member_index : public secondary_index
    {
       public:
+         account_member_index();
+         ~account_member_index();
+
          virtual void object_inserted( const object& obj ) override;
+         /** builds the entries for a batch of accounts from sorted runs rather than one insert at a time */
+         virtual void objects_inserted( const vector<const object*>& objs ) override;
+         /**
+          *  Reads the members of the accounts loaded from disk and builds the entries from them on a background
+          *  thread, so that the node need not wait for them to start up.
+          */
+         virtual void objects_loaded( const vector<const object*>& objs ) override;
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
 
+         /**
+          *  @return the accounts which reference the account or key in their owner authority
+          *
+          *  Waits for a build started by @ref objects_loaded to finish.
+          */
+         vector<account_id_type> get_account_references( account_id_type account )const;
+         vector<account_id_type> get_key_references( const public_key_type& key )const;
+         /** looks up several keys while waiting for the build only once */
+         vector<vector<account_id_type>> get_key_references( const vector<public_key_type>& keys )const;
 
-         /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
-         map< account_id_type, set<account_id_type> > account_to_account_memberships;
-         map< public_key_type, set<account_id_type> > account_to_key_memberships;
-
+         /** the accounts referencing one account or key, kept sorted in a single allocation */
+         template<typename Key>
+         using member_map = unordered_map< Key, flat_set<account_id_type>, boost::hash<Key> >;
 
       protected:
          set<account_id_type>  get_account_members( const account_object& a )const;
@@ -256,6 +279,22 @@ namespace graphene { namespace chain {
 
          set<account_id_type>  before_account_members;
          set<public_key_type>  before_key_members;
+
+      private:
+         struct build_state;
+
+         void change_account_member( account_id_type account, account_id_type member, bool add );
+         void change_key_member( const public_key_type& key, account_id_type member, bool add );
+         /** @return true while a background build is running, handing its result over once it has finished */
+         bool building()const;
+         void finish_build()const;
+
+         /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
+         mutable member_map<account_id_type>                  account_to_account_memberships;
+         mutable member_map<public_key_type>                  account_to_key_memberships;
+
+         /** lookups are const, but hand a finished build over before reading */
+         mutable std::unique_ptr<build_state>                 _build;
    };
 
    /**
@@ -271,7 +310,24 @@ namespace graphene { namespace chain {
          virtual void object_modified( const object& after  ) override;
 
          /** maps the referrer to the set of accounts that they have referred */
-         map< account_id_type, set<account_id_type> > referred_by;
+         account_member_index::member_map<account_id_type> referred_by;
+   };
+
+   /**
+    *  @brief This secondary index on the account statistics tracks the accounts which have paid fees that
+    *  @ref account_statistics_object::process_fees has not yet paid out, so maintenance need not visit every account.
+    */
+   class pending_fees_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override { object_changed( obj ); }
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after  ) override { object_changed( after ); }
+
+         void object_changed( const object& obj );
+
+         /** ordered by id, the order in which maintenance processes fees */
+         set<account_id_type> accounts_with_pending_fees;
    };
 
    struct by_asset;
@@ -335,6 +391,7 @@ FC_REFLECT_DERIVED( graphene::chain::meta_account_object,
                     (memo_key)(committee_member_id) )
 
 FC_REFLECT_DERIVED( graphene::chain::account_statistics_object, (graphene::chain::object),
+                    (owner)
                     (most_recent_op)
                     (total_core_in_orders)
                     (lifetime_fees_paid)
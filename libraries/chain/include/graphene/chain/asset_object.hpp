@@ -164,6 +164,9 @@ namespace graphene { namespace chain {
          static const uint8_t space_id = implementation_ids;
          static const uint8_t type_id  = impl_asset_bitasset_data_type;
 
+         /// The asset this data belongs to
+         asset_id_type asset_id;
+
          /// The tunable options for BitAssets are stored in this field.
          bitasset_options options;
 
@@ -204,6 +207,9 @@ namespace graphene { namespace chain {
          time_point_sec feed_expiration_time()const
          { return current_feed_publication_time + options.feed_lifetime_sec; }
          bool feed_is_expired(time_point_sec current_time)const
+         { return feed_expiration_time() <= current_time; }
+         /// The expiration test used before GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME; it holds while the feed is live
+         bool feed_is_expired_before_hardfork(time_point_sec current_time)const
          { return feed_expiration_time() >= current_time; }
          void update_median_feeds(time_point_sec current_time);
    };
@@ -214,12 +220,47 @@ namespace graphene { namespace chain {
       asset_bitasset_data_object,
       indexed_by<
          hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-         ordered_non_unique< tag<by_feed_expiration>,
-            const_mem_fun< asset_bitasset_data_object, time_point_sec, &asset_bitasset_data_object::feed_expiration_time >
+         // ties are broken by id, as update_expired_feeds checks the call orders of the assets in this order
+         ordered_unique< tag<by_feed_expiration>,
+            composite_key< asset_bitasset_data_object,
+               const_mem_fun< asset_bitasset_data_object, time_point_sec, &asset_bitasset_data_object::feed_expiration_time >,
+               member< object, object_id_type, &object::id >
+            >
          >
       >
    > asset_bitasset_data_object_multi_index_type;
-   typedef flat_index<asset_bitasset_data_object> asset_bitasset_data_index;
+   typedef generic_index<asset_bitasset_data_object, asset_bitasset_data_object_multi_index_type> asset_bitasset_data_index;
+
+   /**
+    *  @brief records the market-issued assets whose options or bitasset data changed since update_expired_feeds last
+    *  ran, so that it only has to bring those assets' core exchange rates in line with their feeds.
+    *
+    *  This is a secondary index on the asset_index; changes to bitasset data reach it through an
+    *  @ref changed_bitasset_index::observer attached to the asset_bitasset_data_index.
+    */
+   class changed_bitasset_index : public secondary_index
+   {
+      public:
+         /** forwards changes to bitasset data to a changed_bitasset_index */
+         class observer : public secondary_index
+         {
+            public:
+               observer( changed_bitasset_index& changed ):_changed(changed){}
+
+               virtual void object_inserted( const object& obj ) override { _changed.object_changed( obj ); }
+               virtual void object_modified( const object& after ) override { _changed.object_changed( after ); }
+
+            private:
+               changed_bitasset_index& _changed;
+         };
+
+         virtual void object_inserted( const object& obj ) override { object_changed( obj ); }
+         virtual void object_modified( const object& after ) override { object_changed( after ); }
+
+         void object_changed( const object& obj );
+
+         flat_set<asset_id_type> changed_assets;
+   };
 
    struct by_symbol;
    typedef multi_index_container<
@@ -237,6 +278,7 @@ FC_REFLECT_DERIVED( graphene::chain::asset_dynamic_data_object, (graphene::db::o
                     (current_supply)(accumulated_fees)(fee_pool) )
 
 FC_REFLECT_DERIVED( graphene::chain::asset_bitasset_data_object, (graphene::db::object),
+                    (asset_id)
                     (feeds)
                     (current_feed)
                     (current_feed_publication_time)
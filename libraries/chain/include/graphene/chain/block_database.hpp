@@ -16,28 +16,166 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #pragma once
-#include <fstream>
 #include <graphene/chain/protocol/block.hpp>
 
+#include <atomic>
+#include <mutex>
+
 namespace graphene { namespace chain {
+   struct index_entry;
+   struct header_entry;
+
+   /** a block header together with what is otherwise only known from the whole block */
+   struct indexed_block_header : public signed_block_header
+   {
+      indexed_block_header() {}
+      indexed_block_header( const signed_block& b, const block_id_type& id )
+      :signed_block_header( b ),block_id( id ),transaction_count( b.transactions.size() ){}
+
+      block_id_type  block_id;
+      uint32_t       transaction_count = 0;
+   };
+
+   /**
+    *  Stores blocks in an append-only data file with a fixed-width index of one entry per block number.
+    *
+    *  Both files are accessed with positional reads and writes, so no method moves a shared file position.  Blocks
+    *  are stored and removed by a single thread, while any number of threads may read concurrently without locking:
+    *  a store writes the data and its index entry before publishing the new size of the files.  A reader racing with
+    *  the removal or replacement of the block it asked for gets either block or none, as every block read is checked
+    *  against the id in its index entry.
+    *
+    *  A block database may instead be compressed, which is chosen when it is created.  Blocks are then grouped into
+    *  chunks of @ref blocks_per_chunk consecutive block numbers.  The chunk being filled is kept uncompressed in a
+    *  tail file; once its last block is stored it is compressed with zlib and appended to the chunk file.  Reading a
+    *  block from a compressed chunk decompresses the whole chunk, and the most recently used chunks are cached, so
+    *  sequential reads decompress each chunk once.  Blocks can only be appended to, and removed from the end of, a
+    *  compressed block database, which is how the chain uses it.
+    *
+    *  In either format the header of every block is also kept uncompressed in a file of fixed-size records, so that
+    *  headers are read with a single positional read and without decoding any transactions.
+    *
+    *  A block database may also be told to retain only the most recent blocks.  Older blocks are then pruned from the
+    *  front of every file, in steps of @ref blocks_per_chunk blocks, by freeing the disk space they occupied without
+    *  moving the retained data, so all file positions stay valid.  A pruned index entry reads as zero, which is how
+    *  the first retained block is found again when the block database is opened.
+    */
    class block_database 
    {
       public:
-         void open( const fc::path& dbdir );
+         static const uint32_t blocks_per_chunk = 256;
+
+         block_database();
+         ~block_database();
+
+         /**
+          *  @param compress_new whether to create a compressed block database if there is none in dbdir yet; an
+          *  existing one is opened in the format it was created with
+          */
+         void open( const fc::path& dbdir, bool compress_new = false );
          bool is_open()const;
+         bool is_compressed()const { return _compressed; }
+         /** waits until every block stored so far is on disk */
          void flush();
          void close();
 
+         /** the number of decompressed chunks kept in memory */
+         void set_chunk_cache_size( uint32_t chunks );
+         /**
+          *  @param blocks the number of most recent blocks to keep, or 0 to keep every block; older blocks are pruned
+          *  as new ones are stored
+          */
+         void set_retain_blocks( uint32_t blocks ) { _retain_blocks = blocks; }
+         /**
+          *  Makes an empty block database begin at block first_num, as if every block before it had been pruned, so
+          *  that the blocks of a pruned block database can be copied into it.
+          */
+         void start_at( uint32_t first_num );
+
          void store( const block_id_type& id, const signed_block& b );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
+         /**
+          *  @return the ids of the stored blocks first_num, first_num + 1, ... up to count of them, read from the index
+          *  at once; the result stops short at the first block which is not stored
+          */
+         vector<block_id_type>  fetch_block_ids( uint32_t first_num, uint32_t count )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
+
+         optional<indexed_block_header> fetch_header_by_number( uint32_t block_num )const;
+         /**
+          *  @return the headers of the stored blocks first_num, first_num + 1, ... up to count of them; the result stops
+          *  short at the first block which is not stored
+          */
+         vector<indexed_block_header>   fetch_headers( uint32_t first_num, uint32_t count )const;
+         /** @return the number of the highest stored block, or 0 if there are none */
+         uint32_t               last_block_num()const { return _last_block_num.load( std::memory_order_acquire ); }
+         /** @return the number of the lowest block which has not been pruned, which is 1 unless blocks are pruned */
+         uint32_t               first_block_num()const { return _first_block_num.load( std::memory_order_acquire ); }
+
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         typedef std::shared_ptr<const vector<char>> chunk_data;
+
+         struct cached_chunk
+         {
+            uint32_t    chunk = 0;
+            uint64_t    last_use = 0;
+            chunk_data  data;
+         };
+
+         static uint32_t        chunk_of( uint32_t block_num ) { return (block_num - 1) / blocks_per_chunk; }
+
+         bool                   read_entry( uint32_t block_num, index_entry& e )const;
+         optional<signed_block> read_block( uint32_t block_num, const index_entry& e )const;
+         void                   write_entry( uint32_t block_num, const index_entry& e );
+         void                   write_header( uint32_t block_num, const block_id_type& id, const signed_block* b );
+         /** @return the header in the record, falling back to the block if the record is empty or being rewritten */
+         optional<indexed_block_header> read_header( uint32_t block_num, const header_entry& h )const;
+         /** @return the highest stored block which is not above block_num, or 0 */
+         uint32_t               last_stored_at_or_before( uint32_t block_num )const;
+         /** @return the lowest stored block, assuming the stored blocks are contiguous, or 1 if there are none */
+         uint32_t               first_stored()const;
+         /** removes every block below first_num and frees the space they took */
+         void                   prune( uint32_t first_num );
+
+         /** finds the sealed chunks of a compressed block database and recovers from an interrupted seal */
+         void                   open_chunks( const fc::path& dbdir );
+         /** compresses the tail into the next chunk and empties the tail */
+         void                   seal_chunk();
+         /** moves the last compressed chunk back into the empty tail, so that its blocks can be removed */
+         void                   unseal_chunk();
+         /** @return the decompressed data of a compressed chunk, or null if it cannot be read */
+         chunk_data             load_chunk( uint32_t chunk )const;
+         void                   cache_chunk( uint32_t chunk, const chunk_data& data )const;
+
+         bool                   _compressed = false;
+         /// the block data, or the uncompressed tail of a compressed block database
+         int                    _blocks = -1;
+         int                    _block_num_to_pos = -1;
+         int                    _chunks = -1;
+         int                    _chunk_index = -1;
+         int                    _headers = -1;
+         /// the sizes of the files in bytes, as far as readers may look
+         std::atomic<uint64_t>  _blocks_size;
+         std::atomic<uint64_t>  _index_size;
+         std::atomic<uint64_t>  _headers_size;
+         std::atomic<uint64_t>  _chunks_size;
+         std::atomic<uint32_t>  _sealed_chunks;
+         std::atomic<uint32_t>  _last_block_num;
+         std::atomic<uint32_t>  _first_block_num;
+         uint32_t               _retain_blocks = 0;
+         bool                   _warned_no_hole_punching = false;
+
+         mutable std::mutex             _cache_mutex;
+         mutable vector<cached_chunk>   _chunk_cache;
+         mutable uint64_t               _cache_clock = 0;
+         uint32_t                       _chunk_cache_size = 8;
    };
 } }
+
+FC_REFLECT_DERIVED( graphene::chain::indexed_block_header, (graphene::chain::signed_block_header),
+                    (block_id)(transaction_count) )
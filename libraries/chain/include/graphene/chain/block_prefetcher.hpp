@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/thread/future.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+namespace fc { class thread; }
+
+namespace graphene { namespace chain {
+
+   /** a block read ahead of being applied */
+   struct prefetched_block
+   {
+      signed_block               block;
+      /// the key which signed the block, if signatures are being verified
+      optional<public_key_type>  signee;
+   };
+
+   /**
+    *  @class block_prefetcher
+    *  @brief reads a range of blocks from a @ref block_database on a set of threads, ahead of the thread using them
+    *
+    *  Reading a block, unpacking it and checking its id do not depend on chain state, so while the chain thread
+    *  applies one block the reader threads work on the following ones.  At most queue_depth blocks are read ahead,
+    *  which bounds the memory they take.  The readers may also recover the keys which signed each block and its
+    *  transactions, which is the expensive part of verifying the signatures; the keys are then compared with the
+    *  chain state as each block is applied.
+    *
+    *  With no reader threads every block is read on the calling thread when it is asked for.
+    */
+   class block_prefetcher
+   {
+      public:
+         block_prefetcher( const block_database& blocks, uint32_t first_num, uint32_t last_num,
+                           uint32_t thread_count, uint32_t queue_depth, bool recover_signatures );
+         /** waits for the blocks still being read, which refer to this object */
+         ~block_prefetcher();
+
+         /**
+          *  @return the next block of the range, waiting for it to be read if need be, or null past the end
+          *  @throws if the block cannot be read, or one of its signatures cannot be recovered
+          */
+         optional<prefetched_block> next();
+
+         uint32_t          thread_count()const { return _threads.size(); }
+         /// the total time the reader threads spent reading blocks
+         fc::microseconds  read_time()const { return fc::microseconds( _read_time.load( std::memory_order_relaxed ) ); }
+         /// the total time @ref next spent waiting for a block, including reading it itself without reader threads
+         fc::microseconds  wait_time()const { return _wait_time; }
+
+      private:
+         prefetched_block  read( uint32_t block_num );
+         /** starts reading blocks until queue_depth of them are in flight or the range is exhausted */
+         void              fill();
+
+         const block_database&                        _blocks;
+         const uint32_t                               _last_num;
+         const uint32_t                               _queue_depth;
+         const bool                                   _recover_signatures;
+         uint32_t                                     _next_to_read;
+         vector<std::unique_ptr<fc::thread>>          _threads;
+         std::deque<fc::future<prefetched_block>>     _queue;
+         std::atomic<int64_t>                         _read_time;
+         fc::microseconds                             _wait_time;
+   };
+
+} } // graphene::chain
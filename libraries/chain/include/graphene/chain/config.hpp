@@ -50,6 +50,8 @@
 
 #define GRAPHENE_MIN_UNDO_HISTORY 10
 #define GRAPHENE_MAX_UNDO_HISTORY 1000
+/** the share of the active witnesses which must have built on a block for it to become irreversible */
+#define GRAPHENE_IRREVERSIBLE_THRESHOLD (70 * GRAPHENE_1_PERCENT)
 
 #define GRAPHENE_MIN_BLOCK_SIZE_LIMIT (GRAPHENE_MIN_TRANSACTION_SIZE_LIMIT*5) // 5 transactions per block
 #define GRAPHENE_MIN_TRANSACTION_EXPIRATION_LIMIT (GRAPHENE_MAX_BLOCK_INTERVAL * 5) // 5 transactions per block
@@ -141,6 +143,13 @@
 
 #define GRAPHENE_MAX_INTEREST_APR                            uint16_t( 10000 )
 
+/**
+ *  Before this time every market-issued asset is visited in every block and a price feed only leaves the median in
+ *  a block produced exactly at its expiration time; from this time on feeds are expired by database::update_expired_feeds
+ *  as soon as their lifetime has passed.
+ */
+#define GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME               (fc::time_point_sec( 1446652800 ))
+
 /**
  *  Reserved Account IDs with special meaning
  */
@@ -23,7 +23,11 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
-#include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/genesis_reader.hpp>
+#include <graphene/chain/margin_call_trigger_index.hpp>
+#include <graphene/chain/order_book_index.hpp>
+#include <graphene/chain/transaction_prevalidator.hpp>
+#include <graphene/chain/vote_tally_index.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
@@ -34,6 +38,7 @@
 
 #include <fc/log/logger.hpp>
 
+#include <deque>
 #include <map>
 
 namespace graphene { namespace chain {
@@ -92,6 +97,17 @@ namespace graphene { namespace chain {
             skip_undo_history_check     = 1 << 9   ///< used while reindexing
          };
 
+         /**
+          * The checks skipped when replaying blocks which were fully validated when they were first applied.
+          * Blocks applied with at least these flags set use a specialization of the apply pipeline in which
+          * the checks are removed at compile time.
+          */
+         static const uint32_t replay_skip_flags = skip_witness_signature |
+                                                   skip_transaction_signatures |
+                                                   skip_transaction_dupe_check |
+                                                   skip_tapos_check |
+                                                   skip_authority_check;
+
          /**
           * @brief Open a database, creating a new one if necessary
           *
@@ -101,7 +117,8 @@ namespace graphene { namespace chain {
           * genesis_loader will not be called if an existing database is found.
           *
           * @param data_dir Path to open or create database in
-          * @param genesis_loader A callable object which returns the genesis state to initialize new databases on
+          * @param genesis_loader A callable object which returns the genesis state, or a @ref genesis_reader for it, to
+          * initialize new databases on
           */
          template<typename F>
          void open(const fc::path& data_dir, F&& genesis_loader);
@@ -110,8 +127,18 @@ namespace graphene { namespace chain {
           *
           * This method may be called after or instead of @ref database::open, and will rebuild the object graph by
           * replaying blockchain history. When this method exits successfully, the database will be open.
+          *
+          * Blocks are read and unpacked ahead of being applied on the threads set by @ref set_replay_thread_count.
           */
-         void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
+         void reindex(fc::path data_dir, const genesis_reader& initial_allocation = genesis_state_type());
+         /**
+          * @brief Rebuild object graph from the newest state checkpoint and the blocks after it
+          *
+          * Loads the newest checkpoint written by @ref write_state_checkpoint which matches the block log, and replays
+          * only the blocks after it.  Falls back to the next older checkpoint, and finally to a full @ref reindex, if
+          * a checkpoint cannot be loaded.  When this method exits successfully, the database will be open.
+          */
+         void reindex_from_checkpoint(fc::path data_dir, const genesis_reader& initial_allocation = genesis_state_type());
 
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
@@ -131,8 +158,16 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /** @return the ids of the blocks of the current chain from first_num on, at most count of them */
+         vector<block_id_type>      get_block_ids_for_nums( uint32_t first_num, uint32_t count )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /** @return the header of a block of the current chain, read without the block's transactions if possible */
+         optional<indexed_block_header> fetch_block_header_by_number( uint32_t num )const;
+         /** @return the headers of the blocks of the current chain from first_num on, at most count of them */
+         vector<indexed_block_header>   fetch_block_headers( uint32_t first_num, uint32_t count )const;
+         /** @return the number of the earliest block which can be fetched; the blocks before it have been pruned */
+         uint32_t                   earliest_available_block_num()const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
 
          /**
@@ -167,6 +202,18 @@ namespace graphene { namespace chain {
          void pop_block();
          void clear_pending();
 
+         /**
+          *  Popped blocks keep their state changes, up to this many of them, so that switching back to a fork which was
+          *  applied before replays the changes instead of evaluating the blocks again.  0 disables the cache.
+          *
+          *  A replayed block emits @ref applied_block again with the operations it applied the first time.  Its cached
+          *  changes are captured before its observers run, so the objects they created the first time are not part of
+          *  them and are created again by the observers.
+          */
+         void     set_popped_block_cache_size( uint32_t blocks );
+         /// @return the wall time the most recent switch to another fork took, including any failed attempt
+         fc::microseconds get_last_fork_switch_duration()const { return _last_fork_switch_duration; }
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -174,12 +221,69 @@ namespace graphene { namespace chain {
           *  applied operations is cleared after applying each block and calling the block
           *  observers which may want to index these operations.
           *
+          *  An operation of a transaction is copied, since operation_history_object owns its operation and the block
+          *  observers index these objects as they are.
+          *
           *  @return the op_id which can be used to set the result after it has finished being applied.
           */
          uint32_t  push_applied_operation( const operation& op );
+         /// Moves a virtual operation into the applied operations instead of copying it
+         uint32_t  push_applied_operation( operation&& op );
          void      set_applied_operation_result( uint32_t op_id, const operation_result& r );
          const vector<operation_history_object>& get_applied_operations()const;
 
+         /**
+          *  Sets the number of worker threads used to validate and hash the transactions of a block ahead of their
+          *  evaluation.  Evaluation itself is always performed in block order on the calling thread.  The vote tally at
+          *  maintenance intervals is split across the same threads.
+          */
+         void     set_prevalidation_thread_count( uint32_t thread_count ) { _prevalidator.set_thread_count( thread_count ); }
+         uint32_t get_prevalidation_thread_count()const { return _prevalidator.thread_count(); }
+
+         /**
+          *  Whether @ref open creates a compressed block log when there is none yet.  An existing block log keeps the
+          *  format it was created with; see @ref block_database.
+          */
+         void     set_compress_block_log( bool compress ) { _compress_block_log = compress; }
+         /**
+          *  Keeps only the most recent blocks in the block log, pruning older ones as blocks become irreversible.  A
+          *  pruned block log cannot be replayed.
+          *
+          *  @param blocks the number of blocks to retain, or 0 to keep every block
+          */
+         void     set_block_log_retain( uint32_t blocks ) { _block_id_to_block.set_retain_blocks( blocks ); }
+
+         /**
+          *  The number of threads which read blocks ahead of @ref reindex applying them; with none, each block is read
+          *  when it is applied.
+          */
+         void     set_replay_thread_count( uint32_t thread_count ) { _replay_thread_count = thread_count; }
+         /**
+          *  Whether @ref reindex verifies the witness signature of every block.  The keys are recovered on the replay
+          *  threads, so checking them costs the thread applying blocks little.
+          */
+         void     set_replay_verify_signatures( bool verify ) { _replay_verify_signatures = verify; }
+
+         /**
+          *  Writes a state checkpoint with @ref write_state_checkpoint after every interval pushed blocks, so that
+          *  after a crash @ref reindex_from_checkpoint replays at most that many blocks.  The checkpoint is written
+          *  by push_block itself, so no further block or transaction is processed until the whole state is on disk.
+          *
+          *  @param blocks the interval in blocks, or 0 (the default) to write no checkpoints
+          */
+         void     set_state_checkpoint_interval( uint32_t blocks ) { _state_checkpoint_interval = blocks; }
+
+         /**
+          *  Saves the state at the head block to a new checkpoint in the checkpoints directory, tagged with the head
+          *  block's number and id, and then removes the older checkpoints.  The blocks leading to the head are stored
+          *  in the block log and synced to disk first, so the checkpoint can always be replayed from.  A checkpoint
+          *  only counts once its tag is in place, so a crash while writing one leaves the previous one in use.
+          */
+         void     write_state_checkpoint();
+
+         /// @return the wall time the most recent maintenance interval took to process
+         fc::microseconds get_last_maintenance_duration()const { return _last_maintenance_duration; }
+
          string to_pretty_string( const asset& a )const;
 
          /**
@@ -255,6 +359,7 @@ namespace graphene { namespace chain {
          uint32_t         head_block_num()const;
          block_id_type    head_block_id()const;
          witness_id_type  head_block_witness()const;
+         uint32_t         last_irreversible_block_num()const;
 
          decltype( chain_parameters::block_interval ) block_interval( )const;
 
@@ -282,7 +387,8 @@ namespace graphene { namespace chain {
          void initialize_evaluators();
          /// Reset the object graph in-memory
          void initialize_indexes();
-         void init_genesis(const genesis_state_type& genesis_state = genesis_state_type());
+         /** @param genesis a @ref genesis_reader, or a genesis state in memory */
+         void init_genesis(genesis_reader genesis = genesis_state_type());
 
          template<typename EvaluatorType>
          void register_evaluator()
@@ -361,6 +467,18 @@ namespace graphene { namespace chain {
          void cancel_order(const force_settlement_object& order, bool create_virtual_op = true);
          void cancel_order(const limit_order_object& order, bool create_virtual_op = true);
 
+         /**
+          *  @brief Cancels many limit orders at once, as when they expire
+          *
+          *  Each order is canceled exactly as a limit_order_cancel_operation would cancel it, without the evaluator:
+          *  the operation is emitted with the refund as its result, and call orders in both assets are checked right
+          *  after the order is removed, while the rest of the orders are still on the book.  An order which one of
+          *  those checks filled completely is skipped.
+          *
+          *  @param orders the orders to cancel, in the order their virtual operations should be emitted
+          */
+         void cancel_limit_orders( const vector<limit_order_id_type>& orders );
+
          /**
           * @brief Process a new limit order through the markets
           * @param order The new order to process
@@ -418,19 +536,57 @@ namespace graphene { namespace chain {
          void notify_changed_objects();
 
       private:
+         /** the state changes of a popped block, the operations it applied and the block interval it was applied with */
+         struct popped_block
+         {
+            /** the changes of the block itself, without those of the @ref applied_block observers */
+            graphene::db::redo_state          changes;
+            /** false until @ref changes is filled; a block applied without observers is captured when popped */
+            bool                              changes_captured = false;
+            vector<operation_history_object>  applied_ops;
+            uint8_t                           block_interval = 0;
+         };
+
+         /** @return false if the state changes of the block are not cached, in which case nothing has been done */
+         bool apply_popped_block( const signed_block& b, const block_id_type& id );
+         /** keeps what @ref pop_block caches for a block applied in an undo session of its own */
+         void remember_applied_block( const block_id_type& id, popped_block&& applied );
+
          optional<undo_database::session>       _pending_block_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
+         std::map<block_id_type, popped_block>  _popped_blocks;
+         /// oldest first
+         std::deque<block_id_type>              _popped_block_order;
+         /// the blocks which can still be popped, oldest first
+         std::deque<std::pair<block_id_type, popped_block>> _applied_blocks;
+         uint32_t                               _popped_block_cache_size = 64;
+         fc::microseconds                       _last_fork_switch_duration;
+
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
 
          //////////////////// db_block.cpp ////////////////////
 
          void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
-         processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         /// copies trx into the result, which the pending block keeps; transactions of a block are evaluated in place
+         processed_transaction _apply_transaction( const signed_transaction& trx, const precomputed_transaction* pre = nullptr );
+
+         /**
+          * The apply pipeline, parameterized on skip flags known at compile time.  StaticSkip is or'ed into the
+          * runtime skip flags, so every check it covers folds away together with the lookups supporting it.
+          */
+         ///@{
+         template<uint32_t StaticSkip>
+         void                  _apply_block_impl( const signed_block& next_block );
+         /// Applies trx and returns the results of its operations without copying trx into a processed_transaction
+         template<uint32_t StaticSkip = skip_nothing>
+         vector<operation_result> _apply_transaction_operations( const signed_transaction& trx,
+                                                                 const precomputed_transaction* pre = nullptr );
+         ///@}
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
+         uint32_t              stamp_applied_operation();
 
          ///Steps involved in applying a new block
          ///@{
@@ -442,10 +598,12 @@ namespace graphene { namespace chain {
          //////////////////// db_update.cpp ////////////////////
          void update_global_dynamic_data( const signed_block& b );
          void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
+         void update_last_irreversible_block();
          void update_pending_block(const signed_block& next_block, uint8_t current_block_interval);
          void clear_expired_transactions();
          void clear_expired_proposals();
          void clear_expired_orders();
+         void execute_force_settlements( const asset_object& mia );
          void update_expired_feeds();
          void update_withdraw_permissions();
 
@@ -464,8 +622,7 @@ namespace graphene { namespace chain {
          void update_active_witnesses();
          void update_active_committee_members();
 
-         template<class... Types>
-         void perform_account_maintenance(std::tuple<Types...> helpers);
+         void perform_account_maintenance(const global_property_object& props);
          ///@}
          ///@}
 
@@ -482,6 +639,24 @@ namespace graphene { namespace chain {
           *  the fork tree relatively simple.
           */
          block_database   _block_id_to_block;
+         bool             _compress_block_log = false;
+         uint32_t         _replay_thread_count = 2;
+         bool             _replay_verify_signatures = false;
+         uint32_t         _state_checkpoint_interval = 0;
+         /// the head block when the last checkpoint was written, or when the database was opened
+         uint32_t         _last_checkpoint_block_num = 0;
+         /// the highest block written to _block_id_to_block; the blocks after it are only held by _fork_db
+         uint32_t         _last_stored_block_num = 0;
+
+         /**
+          *  Writes the blocks of the current chain after _last_stored_block_num up to block_num.  This is done as
+          *  blocks become irreversible, and for the rest of them when the database is closed.
+          */
+         void store_blocks_through( uint32_t block_num );
+         /** @return the block numbered num on the current chain if it is held by _fork_db, otherwise null */
+         shared_ptr<fork_item> fetch_reversible_block( uint32_t num )const;
+         /** applies the blocks first_num through last_num from the block log, reading them ahead on the replay threads */
+         void replay_blocks( uint32_t first_num, uint32_t last_num );
 
          /**
           * Contains the set of ops that are in the process of being applied from
@@ -500,37 +675,32 @@ namespace graphene { namespace chain {
          vector<uint64_t>                  _witness_count_histogram_buffer;
          vector<uint64_t>                  _committee_count_histogram_buffer;
          uint64_t                          _total_voting_stake;
+         fc::microseconds                  _last_maintenance_duration;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
-         node_property_object              _node_property_object;
-   };
+         /// owned by the limit order index; see @ref check_call_orders
+         margin_call_trigger_index*        _margin_call_triggers = nullptr;
+         /// owned by the asset index; see @ref update_expired_feeds
+         changed_bitasset_index*           _changed_bitassets = nullptr;
+         /// owned by the limit order index; see @ref apply_order
+         order_book_index*                 _order_books = nullptr;
+         /// owned by the account index; see @ref perform_account_maintenance
+         vote_tally_index*                 _vote_totals = nullptr;
+         /// owned by the account statistics index; see @ref perform_account_maintenance
+         pending_fees_index*               _pending_fees = nullptr;
 
-   namespace detail
-   {
-       template<int... Is>
-       struct seq { };
+         transaction_prevalidator          _prevalidator;
 
-       template<int N, int... Is>
-       struct gen_seq : gen_seq<N - 1, N - 1, Is...> { };
-
-       template<int... Is>
-       struct gen_seq<0, Is...> : seq<Is...> { };
-
-       template<typename T, int... Is>
-       void for_each(T&& t, const account_object& a, seq<Is...>)
-       {
-           auto l = { (std::get<Is>(t)(a), 0)... };
-           (void)l;
-       }
-   }
+         node_property_object              _node_property_object;
+   };
 
    template<typename F>
    void database::open(const fc::path& data_dir, F&& genesis_loader)
    { try {
          object_database::open(data_dir);
 
-         _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+         _block_id_to_block.open(data_dir / "database" / "block_num_to_block", _compress_block_log);
 
          if( !find(global_property_id_type()) )
             init_genesis(genesis_loader());
@@ -539,8 +709,13 @@ namespace graphene { namespace chain {
          _pending_block.timestamp = head_block_time();
 
          auto last_block= _block_id_to_block.last();
+         _last_stored_block_num = 0;
          if( last_block.valid() )
+         {
             _fork_db.start_block( *last_block );
+            _last_stored_block_num = last_block->block_num();
+         }
+         _last_checkpoint_block_num = head_block_num();
 
    } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
@@ -27,10 +27,14 @@ namespace graphene { namespace chain {
    using boost::multi_index_container;
    using namespace boost::multi_index;
 
+   /**
+    *  A node of the fork tree.  The block itself is shared and never modified; its number and id are computed once
+    *  when the node is created.
+    */
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( signed_block_ptr b )
+      :num(b->block_num()),id(b->id()),data( std::move(b) ){}
 
       weak_ptr< fork_item > prev;
       uint32_t              num;
@@ -40,16 +44,16 @@ namespace graphene { namespace chain {
        */
       bool                  invalid = false;
       block_id_type         id;
-      signed_block          data;
+      signed_block_ptr      data;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
    /**
     *  As long as blocks are pushed in order the fork
     *  database will maintain a linked tree of all blocks
-    *  that branch from the start_block.  The tree will
-    *  have a maximum depth of 1024 blocks after which
-    *  the database will start lopping off forks.
+    *  that branch from the start_block.  Blocks older than
+    *  the last irreversible block, which can never be
+    *  switched away from, are dropped by @ref prune.
     *
     *  Every time a block is pushed into the fork DB the
     *  block with the highest block_num will be returned.
@@ -68,10 +72,16 @@ namespace graphene { namespace chain {
          bool                             is_known_block( const block_id_type& id )const;
          shared_ptr<fork_item>            fetch_block( const block_id_type& id )const;
          vector<item_ptr>                 fetch_block_by_number( uint32_t n )const;
-         shared_ptr<fork_item>            push_block(const signed_block& b );
+         shared_ptr<fork_item>            push_block( const signed_block& b );
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
+         /**
+          *  Drops every block below last_irreversible_block_num.  The irreversible block itself is kept as the root
+          *  of the tree, so that forks branching off right after it can still be linked.
+          */
+         void                             prune( uint32_t last_irreversible_block_num );
+
 
          /**
           *  Given two head blocks, return two branches of the fork graph that
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/genesis_state.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @class genesis_reader
+    *  @brief hands a genesis state to @ref database::init_genesis without holding all of it in memory
+    *
+    *  The initial accounts, assets, balances and vesting balances make up nearly all of a large genesis state.  When
+    *  reading a JSON file, everything else (the header) is parsed up front while the file is indexed, and the four
+    *  arrays are parsed a batch of records at a time as they are read.  A reader may also wrap a genesis state which
+    *  is already in memory, in which case each array is handed over as a single batch.
+    *
+    *  The arrays must be read in the order of the genesis state: accounts, assets, balances, vesting balances.  The
+    *  chain id is hashed from the records as they are read, and is available once all four have been.
+    */
+   class genesis_reader
+   {
+      public:
+         /** borrows genesis, which must outlive the reader */
+         genesis_reader( const genesis_state_type& genesis );
+         genesis_reader( genesis_state_type&& genesis );
+         explicit genesis_reader( const fc::path& json_file, size_t batch_size = 10000 );
+
+         /** the genesis state without initial_accounts, initial_assets, initial_balances and initial_vesting_balances */
+         const genesis_state_type& header()const { return *_header; }
+
+         template<typename T>
+         using batch_handler = std::function<void( const vector<T>& batch )>;
+
+         size_t account_count()const         { return _arrays[accounts].count; }
+         size_t asset_count()const           { return _arrays[assets].count; }
+         size_t balance_count()const         { return _arrays[balances].count; }
+         size_t vesting_balance_count()const { return _arrays[vesting_balances].count; }
+
+         /** starts reading the arrays over */
+         void read_accounts( const batch_handler<genesis_state_type::initial_account_type>& handler );
+         void read_assets( const batch_handler<genesis_state_type::initial_asset_type>& handler );
+         void read_balances( const batch_handler<genesis_state_type::initial_balance_type>& handler );
+         void read_vesting_balances( const batch_handler<genesis_state_type::initial_vesting_balance_type>& handler );
+
+         /** @return fc::digest of the complete genesis state */
+         fc::sha256 chain_id()const;
+
+      private:
+         enum array_type { accounts, assets, balances, vesting_balances, array_count };
+
+         struct array_location
+         {
+            /** where the array starts in the JSON file */
+            uint64_t offset = 0;
+            size_t   count = 0;
+         };
+
+         template<typename T>
+         void read_array( array_type which, const vector<T> genesis_state_type::* member,
+                          const batch_handler<T>& handler );
+
+         void count_genesis_arrays();
+         void index_json_file();
+
+         /** the complete genesis state when it is in memory */
+         std::shared_ptr<const genesis_state_type>  _genesis;
+         std::shared_ptr<const genesis_state_type>  _header;
+
+         fc::path                                   _json_file;
+         size_t                                     _batch_size = 0;
+         array_location                             _arrays[array_count];
+
+         uint32_t                                   _arrays_read = 0;
+         /** hashes the genesis state read so far from a JSON file */
+         std::shared_ptr<fc::sha256::encoder>       _chain_id_encoder;
+         fc::sha256                                 _chain_id;
+   };
+
+} } // graphene::chain
@@ -81,11 +81,16 @@ namespace graphene { namespace chain {
          /**
           *  Every time a block is missed this increases by 2, every time a block is found it decreases by 1 it is
           *  never less than 0
-          *
-          *  If the recently_missed_count hits 2*UNDO_HISTORY then no ew blocks may be pushed.  
           */
          uint32_t          recently_missed_count = 0;
 
+         /**
+          *  The highest block which enough of the active witnesses have built on that it can never be switched away
+          *  from.  Only the blocks after it can be undone, and only it and the blocks before it are written to the
+          *  block log.
+          */
+         uint32_t          last_irreversible_block_num = 0;
+
          /** if the interval changes then how we calculate witness participation will
           * also change.  Normally witness participation is defined as % of blocks
           * produced in the last round which is calculated by dividing the delta
@@ -106,6 +111,7 @@ FC_REFLECT_DERIVED( graphene::chain::dynamic_global_property_object, (graphene::
                     (witness_budget)
                     (accounts_registered_this_interval)
                     (recently_missed_count)
+                    (last_irreversible_block_num)
                     (first_maintenance_block_with_current_interval)
                   )
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/protocol/asset.hpp>
+#include <graphene/db/index.hpp>
+
+namespace graphene { namespace chain {
+   using graphene::db::object;
+   using graphene::db::secondary_index;
+
+   class limit_order_object;
+
+   /**
+    *  @brief remembers which market-issued assets check_call_orders has found nothing to do for
+    *
+    *  When a full check of a market finds no call order to execute, the asset is marked idle together with the
+    *  range of limit prices which would have triggered a margin call: at least the maximum short squeeze price of
+    *  the feed, and at most the call limit of the least collateralized position.  While the asset is idle only a
+    *  limit order selling it inside that range can create a margin call, so check_call_orders can return without
+    *  touching the order books.
+    *
+    *  Any change to a call order or to the bitasset data of an asset makes it non-idle, and so does removing a call
+    *  order.  A market left idle because the top of the book is priced beyond the call limit also becomes non-idle
+    *  when an order priced beyond the call limit is removed, since that may uncover an order inside the range.
+    *  Removing any other limit order can only shrink the set of possible margin calls.
+    *
+    *  This is a secondary index on the limit_order_index.  Call orders and bitasset data are observed through
+    *  @ref margin_call_trigger_index::observer instances attached to their own primary indexes.
+    *
+    *  @note this is a cache derived from the order books, call orders and feeds and is not saved with the state,
+    *  but it decides whether check_call_orders looks at a market at all, so it must never mark a market idle which
+    *  could produce a margin call.  It starts empty when the database is opened, so every market gets a full check
+    *  before it can be marked idle again.
+    */
+   class margin_call_trigger_index : public secondary_index
+   {
+      public:
+         /** forwards changes in other primary indexes to a margin_call_trigger_index */
+         class observer : public secondary_index
+         {
+            public:
+               observer( margin_call_trigger_index& triggers ):_triggers(triggers){}
+
+               virtual void object_inserted( const object& obj ) override { _triggers.object_changed( obj ); }
+               virtual void object_modified( const object& after ) override { _triggers.object_changed( after ); }
+               virtual void object_removed( const object& obj ) override { _triggers.object_changed( obj ); }
+
+            private:
+               margin_call_trigger_index& _triggers;
+         };
+
+         virtual void object_inserted( const object& obj ) override { object_changed( obj ); }
+         virtual void object_modified( const object& after ) override { object_changed( after ); }
+         virtual void object_removed( const object& obj ) override;
+
+         /** @return false if check_call_orders is known to find no call order to execute for mia */
+         bool might_call( asset_id_type mia )const { return _idle.find( mia ) == _idle.end(); }
+
+         /**
+          *  Marks mia idle after a full check found no margin call
+          *
+          *  @param squeeze_price the lowest limit price (MIA/collateral) at which calls may be filled
+          *  @param call_limit the highest limit price at which the least collateralized call order would be filled,
+          *         or null if any price may fill one
+          */
+         void set_idle( asset_id_type mia, const price& squeeze_price, const optional<price>& call_limit );
+
+         void object_changed( const object& obj );
+
+      private:
+         void limit_order_changed( const limit_order_object& order );
+
+         struct idle_market
+         {
+            price           squeeze_price;
+            optional<price> call_limit;
+         };
+
+         flat_map<asset_id_type, idle_market> _idle;
+   };
+
+} } // graphene::chain
@@ -43,6 +43,7 @@ namespace graphene { namespace chain {
          static const uint8_t type_id  = operation_history_object_type;
 
          operation_history_object( const operation& o ):op(o){}
+         operation_history_object( operation&& o ):op(std::move(o)){}
          operation_history_object(){}
 
          operation         op;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/protocol/asset.hpp>
+#include <graphene/db/index.hpp>
+
+#include <deque>
+
+namespace graphene { namespace chain {
+   using graphene::db::object;
+   using graphene::db::secondary_index;
+
+   class limit_order_object;
+
+   /**
+    *  @brief a flat, per-market view of the limit order book used by the matching engine
+    *
+    *  Each side of a market (all orders selling one asset for another) is kept as a vector of price levels sorted
+    *  from worst to best price, so the top of the book is the last element.  Each level holds its orders in a FIFO
+    *  ordered by object id, which is the same order the by_price index of the limit_order_index gives them.
+    *
+    *  This is a secondary index on the limit_order_index, which remains the authoritative store and the one the
+    *  API queries; the book only mirrors it.
+    */
+   class order_book_index : public secondary_index
+   {
+      public:
+         /**
+          *  A price reduced to lowest terms, with a floating point approximation of base/quote which decides most
+          *  comparisons without the 128 bit multiplies of price::operator<.  Equal prices have equal keys.
+          */
+         struct price_key
+         {
+            price_key( const price& p );
+
+            int64_t base  = 0;
+            int64_t quote = 0;
+            double  ratio = 0;
+
+            /** @return negative, zero or positive as a is less than, equal to or greater than b */
+            static int compare( const price_key& a, const price_key& b );
+
+            friend bool operator <  ( const price_key& a, const price_key& b ) { return compare( a, b ) <  0; }
+            friend bool operator == ( const price_key& a, const price_key& b ) { return a.base == b.base && a.quote == b.quote; }
+         };
+
+         struct price_level
+         {
+            price_level( const price_key& k ):key(k){}
+
+            price_key                              key;
+            std::deque<const limit_order_object*>  orders;
+         };
+
+         /** all orders selling one asset for another, worst price first */
+         typedef vector<price_level> book_side;
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after ) override;
+
+         /** @return the best priced level of orders selling sell_asset for receive_asset, or nullptr if there are none */
+         const price_level* best_level( asset_id_type sell_asset, asset_id_type receive_asset )const;
+
+         /** @return the orders selling sell_asset for receive_asset, or nullptr if there are none */
+         const book_side* get_side( asset_id_type sell_asset, asset_id_type receive_asset )const;
+
+      private:
+         void add_order( const limit_order_object& order );
+         void remove_order( const limit_order_object& order, const price& sell_price );
+
+         flat_map< std::pair<asset_id_type,asset_id_type>, book_side > _sides;
+         price                                                        _price_before_modify;
+   };
+
+} } // graphene::chain
@@ -51,6 +51,9 @@ namespace graphene { namespace chain {
       vector<processed_transaction> transactions;
    };
 
+   /** an immutable block which can be shared, e.g. between the fork database and the code serving it to peers */
+   typedef shared_ptr<const signed_block> signed_block_ptr;
+
 } } // graphene::chain
 
 FC_REFLECT( graphene::chain::block_header, (previous)(timestamp)(witness)
@@ -337,6 +337,11 @@ namespace graphene { namespace chain {
        friend bool operator == ( const public_key_type& p1, const fc::ecc::public_key& p2);
        friend bool operator == ( const public_key_type& p1, const public_key_type& p2);
        friend bool operator != ( const public_key_type& p1, const public_key_type& p2);
+       /**
+        *  Keys are chosen by whoever registers them, so they are hashed with SipHash under a random key drawn once per
+        *  process; nobody can craft keys that share a bucket of a hash table on another node.
+        */
+       friend size_t hash_value( const public_key_type& k );
        // TODO: This is temporary for testing
        bool is_valid_v1( const std::string& base58str );
    };
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace fc { class thread; }
+
+namespace graphene { namespace chain {
+   /**
+    *  @brief the parts of applying a transaction which do not depend on chain state
+    *
+    *  Validation of the operations and computation of the transaction id only read the transaction itself, so they
+    *  can be performed for every transaction in a block before any of them is evaluated.  A validation failure is
+    *  held here and rethrown when the transaction is reached in block order, so errors surface exactly where they
+    *  would when applying sequentially.
+    */
+   struct precomputed_transaction
+   {
+      transaction_id_type  id;
+      std::exception_ptr   validation_error;
+   };
+
+   /**
+    *  @class worker_pool
+    *  @brief a set of threads which split a range of read-only work with the calling thread
+    *
+    *  The work must not modify the database; the calling thread blocks until every shard is done.
+    */
+   class worker_pool
+   {
+      public:
+         worker_pool( const string& name );
+         ~worker_pool();
+
+         void     set_thread_count( uint32_t thread_count );
+         uint32_t thread_count()const { return _threads.size(); }
+
+         /** @return the largest number of shards @ref run_sharded will use */
+         size_t   max_shards()const { return _threads.size() + 1; }
+
+         /**
+          *  Splits [0, count) into contiguous ranges, one per shard, and calls work( shard, begin, end ) for each.  The
+          *  calling thread takes shard 0.  An exception from any shard is rethrown after all of them have finished.
+          */
+         void run_sharded( size_t count, const std::function<void(size_t shard, size_t begin, size_t end)>& work )const;
+
+      private:
+         string                               _name;
+         vector<std::unique_ptr<fc::thread>>  _threads;
+   };
+
+   /**
+    *  @class transaction_prevalidator
+    *  @brief computes @ref precomputed_transaction entries for a block on a set of worker threads
+    *
+    *  With no worker threads the work is done on the calling thread.  The threads are idle outside of block
+    *  prevalidation, so other read-only passes over the database may borrow them through @ref workers.
+    *
+    *  Evaluation itself is not parallelized: the operations of a block are still evaluated one transaction at a
+    *  time, in block order, on the thread applying the block.
+    */
+   class transaction_prevalidator
+   {
+      public:
+         transaction_prevalidator();
+
+         void     set_thread_count( uint32_t thread_count ) { _workers.set_thread_count( thread_count ); }
+         uint32_t thread_count()const { return _workers.thread_count(); }
+
+         const worker_pool& workers()const { return _workers; }
+
+         /** @param compute_ids false when the ids will not be used, i.e. when the dupe check is skipped */
+         vector<precomputed_transaction> run( const vector<processed_transaction>& trxs, bool compute_ids = true )const;
+
+      private:
+         worker_pool _workers;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/index.hpp>
+
+namespace graphene { namespace chain {
+   using graphene::db::object;
+   using graphene::db::secondary_index;
+
+   class account_object;
+
+   /**
+    *  @brief stake voting for each vote_id and for each desired number of witnesses and committee members
+    *
+    *  The witness and committee counts are kept as voted for, not halved and capped as in the histograms used by
+    *  maintenance, so the totals do not depend on the chain parameters.  total_voting_stake is left to the caller.
+    */
+   struct vote_totals
+   {
+      vector<uint64_t>             votes;
+      flat_map<uint16_t,uint64_t>  witness_count_stake;
+      flat_map<uint16_t,uint64_t>  committee_count_stake;
+      uint64_t                     total_voting_stake = 0;
+
+      void add( const flat_set<vote_id_type>& opinions, uint16_t num_witness, uint16_t num_committee, uint64_t stake );
+      void subtract( const flat_set<vote_id_type>& opinions, uint16_t num_witness, uint16_t num_committee,
+                     uint64_t stake );
+      void merge( const vote_totals& other );
+   };
+
+   /**
+    *  @brief running vote totals of every account, kept up to date as stakes and opinions change
+    *
+    *  An account votes with its core balance, its core in orders and its cashback balance, and with the opinions of
+    *  its voting_account (or its own).  Each of those lives in a different object, so besides the account_index this
+    *  index observes the account_balance_index, the account_statistics_object index and the vesting_balance_index
+    *  through @ref vote_tally_index::observer instances.  Whenever one of them changes, the stake of the account it
+    *  belongs to is moved from where it was counted to where it now belongs.
+    *
+    *  Membership lapses with time rather than through an object change, so the totals count every account as if
+    *  count_non_member_votes were set.
+    *
+    *  @note this is a cache derived from the accounts and balances and is not saved with the state, but maintenance
+    *  elects witnesses and committee members from its totals, so they must stay exactly equal to a full tally.  They
+    *  are rebuilt from scratch as objects are loaded when the database is opened.
+    */
+   class vote_tally_index : public secondary_index
+   {
+      public:
+         /** forwards changes in other primary indexes to a vote_tally_index */
+         class observer : public secondary_index
+         {
+            public:
+               observer( vote_tally_index& tally ):_tally(tally){}
+
+               virtual void object_inserted( const object& obj ) override { _tally.object_changed( obj, false ); }
+               virtual void object_modified( const object& after ) override { _tally.object_changed( after, false ); }
+               virtual void object_removed( const object& obj ) override { _tally.object_changed( obj, true ); }
+
+            private:
+               vote_tally_index& _tally;
+         };
+
+         virtual void object_inserted( const object& obj ) override { object_changed( obj, false ); }
+         virtual void object_modified( const object& after ) override { object_changed( after, false ); }
+         virtual void object_removed( const object& obj ) override { object_changed( obj, true ); }
+
+         void object_changed( const object& obj, bool removed );
+
+         const vote_totals& totals()const { return _totals; }
+
+         /**
+          *  Until @ref end_recording, also applies changes of stake to into, but only those of accounts after the one
+          *  most recently passed to @ref record_changes_after.  Maintenance uses this to count cashback paid while
+          *  processing fees the way a single pass over the accounts in id order would.
+          */
+         void begin_recording( vote_totals& into ) { _recording = &into; _record_after = 0; }
+         void record_changes_after( account_id_type account ) { _record_after = account.instance.value; }
+         void end_recording() { _recording = nullptr; }
+
+      private:
+         static const uint64_t none = uint64_t(-1);
+
+         struct voter
+         {
+            bool                    exists = false;
+            uint64_t                core_balance = 0;
+            uint64_t                statistics = none;
+            uint64_t                cashback_vb = none;
+            uint64_t                opinion_account = none;
+
+            /// the stake of this account as counted in the totals, and the account whose opinions it was counted with
+            uint64_t                counted_stake = 0;
+            uint64_t                counted_opinion_account = none;
+
+            /// the opinions of this account, and the stake counted with them
+            flat_set<vote_id_type>  votes;
+            uint16_t                num_witness = 0;
+            uint16_t                num_committee = 0;
+            uint64_t                proxied_stake = 0;
+         };
+
+         voter&    get_voter( uint64_t account );
+         uint64_t& get_slot( vector<uint64_t>& slots, uint64_t instance, uint64_t initial = 0 );
+
+         void account_changed( const account_object& a, bool removed );
+         /** moves the stake of an account to wherever its current balances and voting_account say it belongs */
+         void update_stake( uint64_t account );
+         void move_stake( uint64_t account, uint64_t opinion_account, uint64_t stake, bool add );
+
+         vector<voter>     _voters;
+         /// by instance of account_statistics_object
+         vector<uint64_t>  _core_in_orders;
+         vector<uint64_t>  _statistics_owner;
+         /// by instance of vesting_balance_object
+         vector<uint64_t>  _vesting_balance;
+
+         vote_totals       _totals;
+         vote_totals*      _recording = nullptr;
+         uint64_t          _record_after = 0;
+   };
+
+} } // graphene::chain
@@ -38,6 +38,8 @@ namespace graphene { namespace chain {
          optional< vesting_balance_id_type > pay_vb;
          vote_id_type     vote_id;
          string           url;
+         /** the last block this witness produced; producing a block confirms it and every block before it */
+         uint32_t         last_confirmed_block_num = 0;
 
          witness_object() : vote_id(vote_id_type::witness) {}
    };
@@ -64,4 +66,5 @@ FC_REFLECT_DERIVED( graphene::chain::witness_object, (graphene::db::object),
                     (previous_secret)
                     (pay_vb)
                     (vote_id)
-                    (url) )
+                    (url)
+                    (last_confirmed_block_num) )
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/margin_call_trigger_index.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_evaluator.hpp>
+
+namespace graphene { namespace chain {
+
+void margin_call_trigger_index::set_idle( asset_id_type mia, const price& squeeze_price, const optional<price>& call_limit )
+{
+   auto& market = _idle[mia];
+   market.squeeze_price = squeeze_price;
+   market.call_limit = call_limit;
+}
+
+void margin_call_trigger_index::object_changed( const object& obj )
+{
+   if( _idle.empty() )
+      return;
+
+   if( obj.id.space() == protocol_ids && obj.id.type() == limit_order_object_type )
+   {
+      assert( dynamic_cast<const limit_order_object*>(&obj) );
+      limit_order_changed( static_cast<const limit_order_object&>(obj) );
+   }
+   else if( obj.id.space() == protocol_ids && obj.id.type() == call_order_object_type )
+   {
+      assert( dynamic_cast<const call_order_object*>(&obj) );
+      _idle.erase( static_cast<const call_order_object&>(obj).debt_type() );
+   }
+   else if( obj.id.space() == implementation_ids && obj.id.type() == impl_asset_bitasset_data_type )
+   {
+      assert( dynamic_cast<const asset_bitasset_data_object*>(&obj) );
+      _idle.erase( static_cast<const asset_bitasset_data_object&>(obj).asset_id );
+   }
+}
+
+void margin_call_trigger_index::object_removed( const object& obj )
+{
+   if( _idle.empty() )
+      return;
+
+   assert( dynamic_cast<const limit_order_object*>(&obj) );
+   const limit_order_object& order = static_cast<const limit_order_object&>(obj);
+   auto itr = _idle.find( order.sell_price.base.asset_id );
+   if( itr == _idle.end() )
+      return;
+   const idle_market& market = itr->second;
+   if( order.sell_price.quote.asset_id != market.squeeze_price.quote.asset_id )
+      return;
+
+   // Only a market stopped by a top of the book beyond the call limit can be uncovered, and only by removing an
+   // order beyond the call limit, as the top is.
+   if( market.call_limit.valid() && order.sell_price > *market.call_limit )
+      _idle.erase( itr );
+}
+
+void margin_call_trigger_index::limit_order_changed( const limit_order_object& order )
+{
+   auto itr = _idle.find( order.sell_price.base.asset_id );
+   if( itr == _idle.end() )
+      return;
+   const idle_market& market = itr->second;
+   if( order.sell_price.quote.asset_id != market.squeeze_price.quote.asset_id )
+      return;
+
+   // These are the bounds check_call_orders applies to the top of the book and the first call order.
+   if( market.squeeze_price > order.sell_price )
+      return;
+   if( market.call_limit.valid() && order.sell_price > *market.call_limit )
+      return;
+   _idle.erase( itr );
+}
+
+} } // graphene::chain
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/order_book_index.hpp>
+#include <graphene/chain/market_evaluator.hpp>
+
+#include <fc/uint128.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+static int64_t greatest_common_divisor( int64_t a, int64_t b )
+{
+   while( b != 0 )
+   {
+      auto r = a % b;
+      a = b;
+      b = r;
+   }
+   return a;
+}
+
+order_book_index::price_key::price_key( const price& p )
+{
+   assert( p.base.amount > 0 && p.quote.amount > 0 );
+   auto divisor = greatest_common_divisor( p.base.amount.value, p.quote.amount.value );
+   base  = p.base.amount.value / divisor;
+   quote = p.quote.amount.value / divisor;
+   ratio = double( base ) / double( quote );
+}
+
+int order_book_index::price_key::compare( const price_key& a, const price_key& b )
+{
+   if( a == b )
+      return 0;
+
+   // doubles only carry 53 bits, so leave prices which are close for the exact comparison
+   const double tolerance = std::max( a.ratio, b.ratio ) * 1e-9;
+   if( a.ratio < b.ratio - tolerance ) return -1;
+   if( a.ratio > b.ratio + tolerance ) return 1;
+
+   const auto amult = fc::uint128( uint64_t( a.base ) ) * uint64_t( b.quote );
+   const auto bmult = fc::uint128( uint64_t( b.base ) ) * uint64_t( a.quote );
+   if( amult < bmult ) return -1;
+   return amult == bmult ? 0 : 1;
+}
+
+static bool level_before_key( const order_book_index::price_level& level, const order_book_index::price_key& key )
+{
+   return level.key < key;
+}
+
+void order_book_index::add_order( const limit_order_object& order )
+{
+   auto& side = _sides[ std::make_pair( order.sell_price.base.asset_id, order.sell_price.quote.asset_id ) ];
+   price_key key( order.sell_price );
+
+   auto level_itr = std::lower_bound( side.begin(), side.end(), key, level_before_key );
+   if( level_itr == side.end() || !(level_itr->key == key) )
+      level_itr = side.insert( level_itr, price_level( key ) );
+
+   // new orders have the highest id so far; only undo restores older ones
+   auto& orders = level_itr->orders;
+   if( orders.empty() || orders.back()->id < order.id )
+      orders.push_back( &order );
+   else
+      orders.insert( std::upper_bound( orders.begin(), orders.end(), &order,
+                                       []( const limit_order_object* a, const limit_order_object* b ) { return a->id < b->id; } ),
+                     &order );
+}
+
+void order_book_index::remove_order( const limit_order_object& order, const price& sell_price )
+{
+   auto side_itr = _sides.find( std::make_pair( sell_price.base.asset_id, sell_price.quote.asset_id ) );
+   FC_ASSERT( side_itr != _sides.end() );
+   auto& side = side_itr->second;
+   price_key key( sell_price );
+
+   auto level_itr = std::lower_bound( side.begin(), side.end(), key, level_before_key );
+   FC_ASSERT( level_itr != side.end() && level_itr->key == key );
+
+   // orders are filled and canceled from the front of the queue far more often than from anywhere else
+   auto& orders = level_itr->orders;
+   if( orders.front() == &order )
+      orders.pop_front();
+   else
+   {
+      auto itr = std::find( orders.begin(), orders.end(), &order );
+      FC_ASSERT( itr != orders.end() );
+      orders.erase( itr );
+   }
+
+   if( orders.empty() )
+   {
+      side.erase( level_itr );
+      if( side.empty() )
+         _sides.erase( side_itr );
+   }
+}
+
+void order_book_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) );
+   add_order( static_cast<const limit_order_object&>(obj) );
+}
+
+void order_book_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) );
+   const limit_order_object& order = static_cast<const limit_order_object&>(obj);
+   remove_order( order, order.sell_price );
+}
+
+void order_book_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const limit_order_object*>(&before) );
+   _price_before_modify = static_cast<const limit_order_object&>(before).sell_price;
+}
+
+void order_book_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const limit_order_object*>(&after) );
+   const limit_order_object& order = static_cast<const limit_order_object&>(after);
+   // fills only change for_sale; the order keeps its place in the queue
+   if( order.sell_price == _price_before_modify )
+      return;
+   remove_order( order, _price_before_modify );
+   add_order( order );
+}
+
+const order_book_index::book_side* order_book_index::get_side( asset_id_type sell_asset, asset_id_type receive_asset )const
+{
+   auto itr = _sides.find( std::make_pair( sell_asset, receive_asset ) );
+   if( itr == _sides.end() )
+      return nullptr;
+   return &itr->second;
+}
+
+const order_book_index::price_level* order_book_index::best_level( asset_id_type sell_asset, asset_id_type receive_asset )const
+{
+   const book_side* side = get_side( sell_asset, receive_asset );
+   if( side == nullptr )
+      return nullptr;
+   // empty sides are erased, so there is always a level here
+   return &side->back();
+}
+
+} } // graphene::chain
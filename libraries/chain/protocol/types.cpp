@@ -23,8 +23,72 @@
 #include <fc/exception/exception.hpp>
 #include <fc/io/raw.hpp>
 
+#include <random>
+
 namespace graphene { namespace chain {
 
+    namespace {
+       struct hash_seed
+       {
+          hash_seed()
+          {
+             std::random_device rd;
+             k0 = (uint64_t( rd() ) << 32) | rd();
+             k1 = (uint64_t( rd() ) << 32) | rd();
+          }
+          uint64_t k0;
+          uint64_t k1;
+       };
+
+       inline uint64_t rotl( uint64_t x, int b ) { return (x << b) | (x >> (64 - b)); }
+
+       /** SipHash-2-4 of the len bytes at data, under the key k0, k1 */
+       uint64_t siphash( const char* data, size_t len, uint64_t k0, uint64_t k1 )
+       {
+          uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+          uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+          uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+          uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+          auto sip_round = [&]() {
+             v0 += v1; v1 = rotl( v1, 13 ); v1 ^= v0; v0 = rotl( v0, 32 );
+             v2 += v3; v3 = rotl( v3, 16 ); v3 ^= v2;
+             v0 += v3; v3 = rotl( v3, 21 ); v3 ^= v0;
+             v2 += v1; v1 = rotl( v1, 17 ); v1 ^= v2; v2 = rotl( v2, 32 );
+          };
+          auto compress = [&]( uint64_t m ) {
+             v3 ^= m;
+             sip_round();
+             sip_round();
+             v0 ^= m;
+          };
+
+          const unsigned char* in = (const unsigned char*)data;
+          const size_t whole = len - len % 8;
+          for( size_t i = 0; i < whole; i += 8 )
+          {
+             uint64_t m = 0;
+             for( int b = 0; b < 8; ++b )
+                m |= uint64_t( in[i + b] ) << (8 * b);
+             compress( m );
+          }
+          uint64_t last = uint64_t( len ) << 56;
+          for( size_t b = 0; b < len % 8; ++b )
+             last |= uint64_t( in[whole + b] ) << (8 * b);
+          compress( last );
+
+          v2 ^= 0xff;
+          for( int i = 0; i < 4; ++i )
+             sip_round();
+          return v0 ^ v1 ^ v2 ^ v3;
+       }
+    }
+
+    size_t hash_value( const public_key_type& k )
+    {
+       static const hash_seed seed;
+       return size_t( siphash( k.key_data.data, k.key_data.size(), seed.k0, seed.k1 ) );
+    }
+
     public_key_type::public_key_type():key_data(){};
 
     public_key_type::public_key_type( const fc::ecc::public_key_data& data )
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/transaction_prevalidator.hpp>
+
+#include <fc/thread/thread.hpp>
+
+namespace graphene { namespace chain {
+
+worker_pool::worker_pool( const string& name ):_name(name) {}
+worker_pool::~worker_pool() {}
+
+void worker_pool::set_thread_count( uint32_t thread_count )
+{
+   while( _threads.size() > thread_count )
+   {
+      _threads.back()->quit();
+      _threads.pop_back();
+   }
+   while( _threads.size() < thread_count )
+      _threads.emplace_back( new fc::thread( _name + fc::to_string( uint64_t(_threads.size()) ) ) );
+}
+
+void worker_pool::run_sharded( size_t count, const std::function<void(size_t,size_t,size_t)>& work )const
+{
+   if( _threads.empty() || count < 2 )
+   {
+      work( 0, 0, count );
+      return;
+   }
+
+   // Each shard is a disjoint, contiguous slice; the calling thread takes the first one.
+   const size_t shards = std::min( max_shards(), count );
+   const size_t per_shard = (count + shards - 1) / shards;
+   vector<fc::future<void>> pending;
+   pending.reserve( shards - 1 );
+   for( size_t s = 1; s < shards; ++s )
+   {
+      size_t begin = s * per_shard;
+      size_t end = std::min( begin + per_shard, count );
+      if( begin >= end )
+         break;
+      pending.emplace_back( _threads[s-1]->async( [&work, s, begin, end]() {
+         work( s, begin, end );
+      }, "run_sharded" ) );
+   }
+
+   // the other shards refer to the caller's data, so they must finish even if this one throws
+   std::exception_ptr error;
+   try {
+      work( 0, 0, std::min( per_shard, count ) );
+   } catch( ... ) {
+      error = std::current_exception();
+   }
+   for( auto& f : pending )
+   {
+      try {
+         f.wait();
+      } catch( ... ) {
+         if( !error )
+            error = std::current_exception();
+      }
+   }
+   if( error )
+      std::rethrow_exception( error );
+}
+
+transaction_prevalidator::transaction_prevalidator():_workers( "prevalidate" ) {}
+
+static void precompute_range( const vector<processed_transaction>& trxs, vector<precomputed_transaction>& result,
+                              size_t begin, size_t end, bool compute_ids )
+{
+   for( size_t i = begin; i < end; ++i )
+   {
+      try {
+         trxs[i].validate();
+         if( compute_ids )
+            result[i].id = trxs[i].id();
+      } catch( ... ) {
+         result[i].validation_error = std::current_exception();
+      }
+   }
+}
+
+vector<precomputed_transaction> transaction_prevalidator::run( const vector<processed_transaction>& trxs,
+                                                               bool compute_ids )const
+{
+   vector<precomputed_transaction> result( trxs.size() );
+   // each shard fills a disjoint slice of result
+   _workers.run_sharded( trxs.size(), [&trxs, &result, compute_ids]( size_t, size_t begin, size_t end ) {
+      precompute_range( trxs, result, begin, end, compute_ids );
+   });
+   return result;
+}
+
+} } // graphene::chain
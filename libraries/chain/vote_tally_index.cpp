@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/vote_tally_index.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+namespace graphene { namespace chain {
+
+void vote_totals::add( const flat_set<vote_id_type>& opinions, uint16_t num_witness, uint16_t num_committee,
+                       uint64_t stake )
+{
+   for( vote_id_type id : opinions )
+   {
+      if( votes.size() <= id.instance() )
+         votes.resize( id.instance() + 1 );
+      votes[id.instance()] += stake;
+   }
+   witness_count_stake[num_witness] += stake;
+   committee_count_stake[num_committee] += stake;
+}
+
+void vote_totals::subtract( const flat_set<vote_id_type>& opinions, uint16_t num_witness, uint16_t num_committee,
+                            uint64_t stake )
+{
+   // unsigned arithmetic wraps, so subtracting is adding the two's complement
+   add( opinions, num_witness, num_committee, uint64_t(0) - stake );
+}
+
+void vote_totals::merge( const vote_totals& other )
+{
+   if( votes.size() < other.votes.size() )
+      votes.resize( other.votes.size() );
+   for( size_t i = 0; i < other.votes.size(); ++i )
+      votes[i] += other.votes[i];
+   for( const auto& item : other.witness_count_stake )
+      witness_count_stake[item.first] += item.second;
+   for( const auto& item : other.committee_count_stake )
+      committee_count_stake[item.first] += item.second;
+   total_voting_stake += other.total_voting_stake;
+}
+
+vote_tally_index::voter& vote_tally_index::get_voter( uint64_t account )
+{
+   if( _voters.size() <= account )
+      _voters.resize( account + 1 );
+   return _voters[account];
+}
+
+uint64_t& vote_tally_index::get_slot( vector<uint64_t>& slots, uint64_t instance, uint64_t initial )
+{
+   if( slots.size() <= instance )
+      slots.resize( instance + 1, initial );
+   return slots[instance];
+}
+
+void vote_tally_index::object_changed( const object& obj, bool removed )
+{
+   if( obj.id.space() == protocol_ids && obj.id.type() == account_object_type )
+   {
+      assert( dynamic_cast<const account_object*>(&obj) );
+      account_changed( static_cast<const account_object&>(obj), removed );
+   }
+   else if( obj.id.space() == implementation_ids && obj.id.type() == impl_account_balance_object_type )
+   {
+      assert( dynamic_cast<const account_balance_object*>(&obj) );
+      const auto& balance = static_cast<const account_balance_object&>(obj);
+      if( balance.asset_type != asset_id_type() )
+         return;
+      get_voter( balance.owner.instance.value ).core_balance = removed ? 0 : balance.balance.value;
+      update_stake( balance.owner.instance.value );
+   }
+   else if( obj.id.space() == implementation_ids && obj.id.type() == impl_account_statistics_object_type )
+   {
+      assert( dynamic_cast<const account_statistics_object*>(&obj) );
+      const auto& stats = static_cast<const account_statistics_object&>(obj);
+      get_slot( _core_in_orders, obj.id.instance() ) = removed ? 0 : stats.total_core_in_orders.value;
+      // the account is created after its statistics; it picks the value up then
+      uint64_t owner = get_slot( _statistics_owner, obj.id.instance(), none );
+      if( owner != none )
+         update_stake( owner );
+   }
+   else if( obj.id.space() == protocol_ids && obj.id.type() == vesting_balance_object_type )
+   {
+      assert( dynamic_cast<const vesting_balance_object*>(&obj) );
+      const auto& vbo = static_cast<const vesting_balance_object&>(obj);
+      get_slot( _vesting_balance, obj.id.instance() ) = removed ? 0 : vbo.balance.amount.value;
+      if( get_voter( vbo.owner.instance.value ).cashback_vb == obj.id.instance() )
+         update_stake( vbo.owner.instance.value );
+   }
+}
+
+void vote_tally_index::account_changed( const account_object& a, bool removed )
+{
+   const uint64_t account = a.id.instance();
+   voter& v = get_voter( account );
+   v.exists = !removed;
+   v.statistics = a.statistics.instance.value;
+   get_slot( _statistics_owner, v.statistics, none ) = removed ? none : account;
+   v.cashback_vb = a.cashback_vb.valid() ? a.cashback_vb->instance.value : none;
+   v.opinion_account = a.options.voting_account == account_id_type() ? account : a.options.voting_account.instance.value;
+
+   // An account which is gone votes for nothing; whatever stake is still counted with it leaves as the accounts
+   // proxying to it are removed or change their voting_account.
+   static const flat_set<vote_id_type> no_votes;
+   const flat_set<vote_id_type>& votes = removed ? no_votes : a.options.votes;
+   const uint16_t num_witness = removed ? 0 : a.options.num_witness;
+   const uint16_t num_committee = removed ? 0 : a.options.num_committee;
+   if( v.votes != votes || v.num_witness != num_witness || v.num_committee != num_committee )
+   {
+      // opinions never change while fees are processed, so there is nothing to record
+      assert( _recording == nullptr );
+      _totals.subtract( v.votes, v.num_witness, v.num_committee, v.proxied_stake );
+      v.votes = votes;
+      v.num_witness = num_witness;
+      v.num_committee = num_committee;
+      _totals.add( v.votes, v.num_witness, v.num_committee, v.proxied_stake );
+   }
+
+   update_stake( account );
+}
+
+void vote_tally_index::update_stake( uint64_t account )
+{
+   voter& v = get_voter( account );
+   uint64_t stake = 0;
+   uint64_t opinion_account = none;
+   if( v.exists )
+   {
+      stake = v.core_balance
+            + (v.statistics < _core_in_orders.size() ? _core_in_orders[v.statistics] : 0)
+            + (v.cashback_vb < _vesting_balance.size() ? _vesting_balance[v.cashback_vb] : 0);
+      opinion_account = v.opinion_account;
+   }
+   if( stake == v.counted_stake && opinion_account == v.counted_opinion_account )
+      return;
+
+   const uint64_t counted_stake = v.counted_stake;
+   const uint64_t counted_opinion_account = v.counted_opinion_account;
+   v.counted_stake = stake;
+   v.counted_opinion_account = opinion_account;
+   // move_stake may grow _voters, so v is not used past this point
+   if( counted_opinion_account != none )
+      move_stake( account, counted_opinion_account, counted_stake, false );
+   if( opinion_account != none )
+      move_stake( account, opinion_account, stake, true );
+}
+
+void vote_tally_index::move_stake( uint64_t account, uint64_t opinion_account, uint64_t stake, bool add )
+{
+   voter& opinions = get_voter( opinion_account );
+   const bool record = _recording != nullptr && account > _record_after;
+   if( add )
+   {
+      opinions.proxied_stake += stake;
+      _totals.add( opinions.votes, opinions.num_witness, opinions.num_committee, stake );
+      _totals.total_voting_stake += stake;
+      if( record )
+      {
+         _recording->add( opinions.votes, opinions.num_witness, opinions.num_committee, stake );
+         _recording->total_voting_stake += stake;
+      }
+   }
+   else
+   {
+      opinions.proxied_stake -= stake;
+      _totals.subtract( opinions.votes, opinions.num_witness, opinions.num_committee, stake );
+      _totals.total_voting_stake -= stake;
+      if( record )
+      {
+         _recording->subtract( opinions.votes, opinions.num_witness, opinions.num_committee, stake );
+         _recording->total_voting_stake -= stake;
+      }
+   }
+}
+
+} } // graphene::chain
@@ -51,6 +51,11 @@ namespace graphene { namespace db {
             modify_callback( _objects[obj.id.instance()] );
          }
 
+         virtual void reserve( size_t count ) override
+         {
+            _objects.reserve( get_next_id().instance() + count );
+         }
+
          virtual const object& insert( object&& obj )override
          {
             auto instance = obj.id.instance();
@@ -22,6 +22,9 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
+
+#include <type_traits>
 
 namespace graphene { namespace chain {
 
@@ -73,6 +76,12 @@ namespace graphene { namespace chain {
             _indices.erase( _indices.iterator_to( static_cast<const ObjectType&>(obj) ) );
          }
 
+         /** only the hashed indices of the container have a capacity to reserve */
+         virtual void reserve( size_t count )override
+         {
+            reserve_hashed<0>( _indices.size() + count );
+         }
+
          virtual const object* find( object_id_type id )const override
          {
             auto itr = _indices.find( id );
@@ -91,6 +100,23 @@ namespace graphene { namespace chain {
          const index_type& indices()const { return _indices; }
 
       private:
+         template<int N>
+         typename std::enable_if< (N < boost::mpl::size<typename index_type::index_type_list>::value) >::type
+         reserve_hashed( size_t count )
+         {
+            reserve_one( _indices.template get<N>(), count, 0 );
+            reserve_hashed<N+1>( count );
+         }
+         template<int N>
+         typename std::enable_if< (N >= boost::mpl::size<typename index_type::index_type_list>::value) >::type
+         reserve_hashed( size_t ) {}
+
+         template<typename Index>
+         static auto reserve_one( Index& idx, size_t count, int ) -> decltype( idx.reserve( count ), void() )
+         { idx.reserve( count ); }
+         template<typename Index>
+         static void reserve_one( Index&, size_t, long ) {}
+
          index_type _indices;
    };
 
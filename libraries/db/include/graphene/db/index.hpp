@@ -28,6 +28,21 @@ namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   /** appends the names of the reflected members of a type, in the order they are serialized, to a description */
+   struct member_name_visitor
+   {
+      member_name_visitor( std::string& desc ):_desc(desc){}
+
+      template<typename Member, class Class, Member (Class::*member)>
+      void operator()( const char* name )const
+      {
+         _desc += ' ';
+         _desc += name;
+      }
+
+      std::string& _desc;
+   };
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -124,6 +139,17 @@ namespace graphene { namespace db {
          virtual void               inspect_all_objects(std::function<void(const object&)> inspector)const = 0;
          virtual void               add_observer( const shared_ptr<index_observer>& ) = 0;
 
+         /** makes room for count more objects where the storage allows it; purely a performance hint */
+         virtual void               reserve( size_t count ) {}
+
+         /**
+          *  While in bulk load mode, create skips undo tracking and the observers, and secondary indexes are told
+          *  about the new objects in one batch when the mode ends or before any object in the index is modified
+          *  or removed.
+          */
+         virtual void               begin_bulk_load() {}
+         virtual void               end_bulk_load() {}
+
    };
 
    class secondary_index
@@ -131,6 +157,17 @@ namespace graphene { namespace db {
       public:
          virtual ~secondary_index(){};
          virtual void object_inserted( const object& obj ){};
+         /** called instead of object_inserted for the objects created in bulk load mode, in creation order */
+         virtual void objects_inserted( const vector<const object*>& objs )
+         {
+            for( const object* obj : objs )
+               object_inserted( *obj );
+         }
+         /**
+          *  called once for all of the objects read when the primary index is opened; an index which is not needed
+          *  to apply blocks may build itself in the background, as long as it reads the objects before returning
+          */
+         virtual void objects_loaded( const vector<const object*>& objs ) { objects_inserted( objs ); }
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
@@ -156,10 +193,11 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
-         template<typename T>
-         void add_secondary_index()
+         template<typename T, typename... Args>
+         T* add_secondary_index( Args&&... args )
          {
-            _sindex.emplace_back( new T() );
+            _sindex.emplace_back( new T( std::forward<Args>(args)... ) );
+            return static_cast<T*>( _sindex.back().get() );
          }
 
          template<typename T>
@@ -208,9 +246,14 @@ namespace graphene { namespace db {
          virtual void           use_next_id()override                    { ++_next_id.number;  }
          virtual void           set_next_id( object_id_type id )override { _next_id = id;      }
 
+         /**
+          *  Identifies the serialized layout of the objects in this index, so that a saved index is not read back
+          *  after a member has been added, removed or reordered; such a database has to be reindexed instead.
+          */
          fc::sha256 get_object_version()const
          {
-            std::string desc = "1.0";//get_type_description<object_type>();
+            std::string desc = "1.0";
+            fc::reflector<object_type>::visit( member_name_visitor( desc ) );
             return fc::sha256::hash(desc);
          }
 
@@ -224,15 +267,25 @@ namespace graphene { namespace db {
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            FC_ASSERT( open_ver == get_object_version(),
+                       "Incompatible Version, the serialization of objects in this index has changed; the blockchain must be replayed" );
+            vector<object_id_type> loaded;
             try {
                vector<char> tmp;
                while( true ) 
                {
                   fc::raw::unpack( ds, tmp );
-                  load( tmp );
+                  loaded.push_back( DerivedIndex::insert( fc::raw::unpack<object_type>( tmp ) ).id );
                }
             } catch ( const fc::exception&  ){}
+
+            // the secondary indexes see everything at once, once nothing will move anymore
+            vector<const object*> objs;
+            objs.reserve( loaded.size() );
+            for( const auto& id : loaded )
+               objs.push_back( this->find( id ) );
+            for( const auto& item : _sindex )
+               item->objects_loaded( objs );
          }
 
          virtual void save( const path& db ) override 
@@ -259,17 +312,39 @@ namespace graphene { namespace db {
          }
 
 
+         /** used by the undo database to restore removed objects; secondary indexes must see them return */
+         virtual const object&  insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
+            if( _bulk_load )
+            {
+               _bulk_created.push_back( result.id );
+               return result;
+            }
             for( const auto& item : _sindex )
                item->object_inserted( result );
             on_add( result );
             return result;
          }
 
+         virtual void begin_bulk_load()override { _bulk_load = true; }
+         virtual void end_bulk_load()override
+         {
+            flush_bulk_created();
+            _bulk_load = false;
+         }
+
          virtual void  remove( const object& obj ) override
          {
+            flush_bulk_created();
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
@@ -278,6 +353,7 @@ namespace graphene { namespace db {
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
+            flush_bulk_created();
             save_undo( obj );
             for( const auto& item : _sindex )
                item->about_to_modify( obj );
@@ -293,7 +369,24 @@ namespace graphene { namespace db {
          }
 
       private:
-         object_id_type _next_id;
+         /** hands the objects created since bulk load mode began to the secondary indexes */
+         void flush_bulk_created()
+         {
+            if( _bulk_created.empty() )
+               return;
+            // ids rather than pointers are kept, as creating may move the objects of a flat index
+            vector<const object*> objs;
+            objs.reserve( _bulk_created.size() );
+            for( const auto& id : _bulk_created )
+               objs.push_back( this->find( id ) );
+            _bulk_created.clear();
+            for( const auto& item : _sindex )
+               item->objects_inserted( objs );
+         }
+
+         object_id_type          _next_id;
+         bool                    _bulk_load = false;
+         vector<object_id_type>  _bulk_created;
    };
 
 } } // graphene::db
@@ -44,6 +44,8 @@ namespace graphene { namespace db {
           * Saves the complete state of the object_database to disk, this could take a while
           */
          void flush();
+         /** saves the complete state as @ref flush does, but under data_dir instead of the directory it was opened in */
+         void save( const fc::path& data_dir );
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -135,6 +137,13 @@ namespace graphene { namespace db {
 
          void pop_undo();
 
+         /**
+          * Puts every index into bulk load mode (see @ref index::begin_bulk_load), for filling the database with
+          * many objects that no undo session or observer needs to hear about, such as at genesis.
+          */
+         void begin_bulk_load();
+         void end_bulk_load();
+
          fc::path get_data_dir()const { return _data_dir; }
 
          /** public for testing purposes only... should be private in practice. */
@@ -18,6 +18,7 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <deque>
+#include <vector>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
@@ -34,6 +35,21 @@ namespace graphene { namespace db {
       unordered_map<object_id_type, unique_ptr<object> > removed;
    };
 
+   /**
+    *  The changes of an undo state as they were before the state was popped, so that they can be applied again
+    *  without repeating whatever produced them.  Only valid on top of the exact state the undo state was popped to.
+    */
+   struct redo_state
+   {
+      /** the final values of objects which existed before */
+      std::vector< unique_ptr<object> >                        modified;
+      /** the final values of objects which were created, in id order */
+      std::vector< unique_ptr<object> >                        created;
+      std::vector< object_id_type >                            removed;
+      /** the next id of each index objects were created in */
+      std::vector< std::pair<object_id_type, object_id_type> > next_ids;
+   };
+
 
    /**
     * @class undo_database
@@ -114,8 +130,25 @@ namespace graphene { namespace db {
           *  note... this is dangerous if there are
           *  active sessions... thus active sessions should
           *  track
+          *
+          *  @param redo if not null, receives what is needed to apply the session again with @ref redo
           */
-         void pop_commit();
+         void pop_commit( redo_state* redo = nullptr );
+
+         /**
+          *  Captures what is needed to apply the changes of the current session again with @ref redo, as
+          *  @ref pop_commit does, while leaving them in place.
+          */
+         void capture( redo_state& redo )const;
+
+         /**
+          *  Applies the changes captured by @ref pop_commit to the current session, recording them for undo exactly as
+          *  if they had been made one by one.
+          */
+         void redo( const redo_state& r );
+
+         /** @return true if changes are being recorded in a session which has been neither committed nor undone */
+         bool in_session()const { return !_disabled && _active_sessions > 0; }
 
          std::size_t size()const { return _stack.size(); }
          void set_max_size(size_t new_max_size) { _max_size = new_max_size; }
@@ -66,13 +66,18 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
+   save( _data_dir );
+}
+
+void object_database::save( const fc::path& data_dir )
+{
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
+      fc::create_directories( data_dir / "object_database" / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+            _index[space][type]->save( data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
    }
 }
 
@@ -96,6 +101,22 @@ void object_database::open(const fc::path& data_dir)
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 
+void object_database::begin_bulk_load()
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->begin_bulk_load();
+}
+
+void object_database::end_bulk_load()
+{ try {
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->end_bulk_load();
+} FC_CAPTURE_AND_RETHROW() }
+
 void object_database::pop_undo()
 { try {
    _undo_db.pop_commit();
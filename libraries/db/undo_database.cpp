@@ -19,6 +19,8 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace db {
 
 void undo_database::enable()  { _disabled = false; }
@@ -149,7 +151,7 @@ void undo_database::commit()
    --_active_sessions;
 }
 
-void undo_database::pop_commit()
+void undo_database::pop_commit( redo_state* redo )
 {
    FC_ASSERT( _active_sessions == 0 );
    FC_ASSERT( !_stack.empty() );
@@ -158,6 +160,9 @@ void undo_database::pop_commit()
    try {
       auto& state = _stack.back();
 
+      if( redo )
+         capture( *redo );
+
       for( auto& item : state.old_values )
       {
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
@@ -186,6 +191,53 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::capture( redo_state& redo )const
+{
+   FC_ASSERT( !_stack.empty() );
+   const auto& state = _stack.back();
+
+   for( auto& item : state.old_values )
+      redo.modified.push_back( _db.get_object( item.first ).clone() );
+   for( const auto& id : state.new_ids )
+      redo.created.push_back( _db.get_object( id ).clone() );
+   std::sort( redo.created.begin(), redo.created.end(),
+              []( const unique_ptr<object>& a, const unique_ptr<object>& b ) { return a->id < b->id; } );
+   for( auto& item : state.removed )
+      redo.removed.push_back( item.first );
+   for( auto& item : state.old_index_next_ids )
+      redo.next_ids.emplace_back( item.first, _db.get_index( item.first.space(), item.first.type() ).get_next_id() );
+}
+
+void undo_database::redo( const redo_state& r )
+{ try {
+   FC_ASSERT( !_disabled );
+   FC_ASSERT( _active_sessions > 0 );
+   auto& state = _stack.back();
+
+   // removals and modifications are recorded by the object database as usual
+   for( const auto& id : r.removed )
+      _db.remove( _db.get_object( id ) );
+   for( const auto& after : r.modified )
+   {
+      auto value = after->clone();
+      _db.modify( _db.get_object( after->id ), [&]( object& obj ){ obj.move_from( *value ); } );
+   }
+
+   // creations restore their final values directly, so record them here
+   for( const auto& item : r.next_ids )
+   {
+      if( state.old_index_next_ids.find( item.first ) == state.old_index_next_ids.end() )
+         state.old_index_next_ids[item.first] = _db.get_index( item.first.space(), item.first.type() ).get_next_id();
+   }
+   for( const auto& created : r.created )
+   {
+      state.new_ids.insert( created->id );
+      _db.insert( std::move( *created->clone() ) );
+   }
+   for( const auto& item : r.next_ids )
+      _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
+} FC_CAPTURE_AND_RETHROW() }
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
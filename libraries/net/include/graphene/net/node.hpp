@@ -154,6 +154,12 @@ namespace graphene { namespace net {
 
          virtual item_hash_t get_head_block_id() const = 0;
 
+         /**
+          * Returns the number of the earliest block we can still serve to peers, which is 1 unless
+          * old blocks have been pruned from our block log.
+          */
+         virtual uint32_t get_earliest_available_block_number() const = 0;
+
          virtual uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const = 0;
 
          virtual void error_encountered(const std::string& message, const fc::oexception& error) = 0;
@@ -255,6 +255,8 @@ namespace graphene { namespace net
       fc::time_point transaction_fetching_inhibited_until;
 
       uint32_t last_known_fork_block_number;
+      /// the peer cannot serve blocks before this one, as it has pruned them from its block log
+      uint32_t earliest_available_block_number;
 
       fc::future<void> accept_or_connect_task_done;
 
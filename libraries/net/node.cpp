@@ -287,6 +287,7 @@ namespace graphene { namespace net { namespace detail {
                                    (get_block_number) \
                                    (get_block_time) \
                                    (get_head_block_id) \
+                                   (get_earliest_available_block_number) \
                                    (estimate_last_known_fork_from_git_revision_timestamp) \
                                    (error_encountered)
 
@@ -387,6 +388,7 @@ namespace graphene { namespace net { namespace detail {
       fc::time_point_sec get_block_time(const item_hash_t& block_id) override;
       fc::time_point_sec get_blockchain_now() override;
       item_hash_t get_head_block_id() const override;
+      uint32_t get_earliest_available_block_number() const override;
       uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const override;
       void error_encountered(const std::string& message, const fc::oexception& error) override;
     };
@@ -1743,6 +1745,10 @@ namespace graphene { namespace net { namespace detail {
       user_data["last_known_block_hash"] = head_block_id;
       user_data["last_known_block_number"] = _delegate->get_block_number(head_block_id);
       user_data["last_known_block_time"] = _delegate->get_block_time(head_block_id);
+      // a node which has pruned its block log cannot serve the blocks before this one to peers that are syncing
+      uint32_t earliest_available_block_number = _delegate->get_earliest_available_block_number();
+      if (earliest_available_block_number > 1)
+        user_data["earliest_available_block_number"] = earliest_available_block_number;
 
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
@@ -1769,6 +1775,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("earliest_available_block_number"))
+        originating_peer->earliest_available_block_number = user_data["earliest_available_block_number"].as<uint32_t>();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -3589,6 +3597,17 @@ namespace graphene { namespace net { namespace detail {
     void node_impl::start_synchronizing_with_peer( const peer_connection_ptr& peer )
     {
       VERIFY_CORRECT_THREAD();
+      uint32_t head_block_num = _delegate->get_block_number(_delegate->get_head_block_id());
+      if( peer->earliest_available_block_number > head_block_num + 1 )
+      {
+        // the peer has pruned the blocks we would need next, so it can only help us once we've caught up from others
+        dlog( "sync: not syncing from peer ${peer}, whose blocks start at ${first} while our head is ${head}",
+              ( "peer", peer->get_remote_endpoint() )( "first", peer->earliest_available_block_number )( "head", head_block_num ) );
+        peer->ids_of_items_to_get.clear();
+        peer->number_of_unfetched_item_ids = 0;
+        peer->we_need_sync_items_from_peer = false;
+        return;
+      }
       peer->ids_of_items_to_get.clear();
       peer->number_of_unfetched_item_ids = 0;
       peer->we_need_sync_items_from_peer = true;
@@ -5206,6 +5225,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_head_block_id);
     }
 
+    uint32_t statistics_gathering_node_delegate_wrapper::get_earliest_available_block_number() const
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_earliest_available_block_number);
+    }
+
     uint32_t statistics_gathering_node_delegate_wrapper::estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const
     {
       INVOKE_AND_COLLECT_STATISTICS(estimate_last_known_fork_from_git_revision_timestamp, unix_timestamp);
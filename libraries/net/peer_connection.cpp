@@ -81,6 +81,7 @@ namespace graphene { namespace net
       inhibit_fetching_sync_blocks(false),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0),
+      earliest_available_block_number(1),
       firewall_check_state(nullptr)
 #ifndef NDEBUG
       ,_thread(&fc::thread::current()),
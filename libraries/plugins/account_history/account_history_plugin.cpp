@@ -96,7 +96,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
 {
    graphene::chain::database& db = database();
    const vector<operation_history_object>& hist = db.get_applied_operations();
-   for( auto op : hist )
+   for( const auto& op : hist )
    {
       // add to the operation history index
       const auto& oho = db.create<operation_history_object>( [&]( operation_history_object& h ){
@@ -174,7 +174,7 @@ void market_history_plugin_impl::update_market_histories( const signed_block& b
 
    graphene::chain::database& db = database();
    const vector<operation_history_object>& hist = db.get_applied_operations();
-   for( auto op : hist )
+   for( const auto& op : hist )
       op.op.visit( operation_process_fill_order( _self, b.timestamp ) );
 }
 
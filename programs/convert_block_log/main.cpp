@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+/**
+ *  Copies the blocks of a block_num_to_block directory into a new one in the other format, e.g. to compress the
+ *  block log of an existing node.  The node must not be running.
+ */
+int main( int argc, char** argv )
+{
+   try {
+      bpo::options_description opts( "Convert a Graphene block log between the plain and compressed formats" );
+      opts.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("source,s", bpo::value<boost::filesystem::path>(), "The existing block log, e.g. witness_node_data_dir/blockchain/database/block_num_to_block")
+            ("destination,d", bpo::value<boost::filesystem::path>(), "The directory to create the converted block log in")
+            ("decompress", "Write a plain block log instead of a compressed one")
+            ;
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, opts ), options );
+      if( options.count("help") || !options.count("source") || !options.count("destination") )
+      {
+         std::cout << opts << "\n";
+         return options.count("help") ? 0 : 1;
+      }
+
+      fc::path source = options.at("source").as<boost::filesystem::path>();
+      fc::path destination = options.at("destination").as<boost::filesystem::path>();
+      FC_ASSERT( fc::exists( source/"index" ), "No block log in ${d}", ("d", source) );
+      FC_ASSERT( !fc::exists( destination/"index" ), "${d} already contains a block log", ("d", destination) );
+
+      block_database in;
+      in.open( source );
+      block_database out;
+      out.open( destination, !options.count("decompress") );
+
+      // a pruned block log stays pruned to the same first block
+      const uint32_t first = in.first_block_num();
+      const uint32_t last = in.last_block_num();
+      if( first > 1 )
+         out.start_at( first );
+      auto start = fc::time_point::now();
+      for( uint32_t num = first; num <= last; ++num )
+      {
+         auto block = in.fetch_by_number( num );
+         FC_ASSERT( block.valid(), "Block ${n} is missing from the source block log", ("n", num) );
+         out.store( block->id(), *block );
+         if( (num - first + 1) % 100000 == 0 )
+            ilog( "Converted ${n} of ${t} blocks", ("n", num - first + 1)("t", last - first + 1) );
+      }
+      out.close();
+      in.close();
+
+      auto size_of = []( const fc::path& dir ) {
+         uint64_t size = 0;
+         for( const char* name : { "blocks", "index", "headers", "tail", "chunks", "chunk_index" } )
+            if( fc::exists( dir/name ) )
+               size += fc::file_size( dir/name );
+         return size;
+      };
+      ilog( "Converted blocks ${f} to ${n} in ${t} ms; ${a} bytes became ${b} bytes",
+            ("f", first)("n", last)("t", (fc::time_point::now() - start).count() / 1000)
+            ("a", size_of( source ))("b", size_of( destination )) );
+   } catch( const fc::exception& e ) {
+      elog( "${e}", ("e", e.to_detail_string()) );
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+namespace {
+   std::atomic<uint64_t> allocation_count( 0 );
+}
+
+// Count every heap allocation made by the benchmark binary so the cost of the apply path can be reported per
+// operation.  The counter is only read around the region being measured.
+void* operator new( std::size_t size )
+{
+   ++allocation_count;
+   if( void* p = std::malloc( size ? size : 1 ) )
+      return p;
+   throw std::bad_alloc();
+}
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, std::size_t ) noexcept { std::free( p ); }
+
+BOOST_FIXTURE_TEST_SUITE( apply_allocations_bench, database_fixture )
+
+BOOST_AUTO_TEST_CASE( allocations_per_applied_operation )
+{
+   try {
+      const uint32_t trx_count = 200;
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      vector<account_id_type> accounts;
+      for( uint32_t i = 0; i < trx_count; ++i )
+      {
+         accounts.push_back( create_account( "alloc" + fc::to_string( uint64_t(i) ) ).id );
+         transfer( account_id_type(), accounts.back(), asset(1000) );
+      }
+      generate_block();
+
+      for( uint32_t i = 0; i < trx_count; ++i )
+      {
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         transfer_operation op;
+         op.from   = accounts[i];
+         op.to     = accounts[(i+1) % trx_count];
+         op.amount = asset(1);
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+      }
+      signed_block b = generate_block( ~0 );
+      db.pop_block();
+
+      uint64_t before = allocation_count.load();
+      db.push_block( b, skip );
+      uint64_t allocations = allocation_count.load() - before;
+
+      ilog( "Applied ${n} transfers with ${a} allocations (${p} per operation)",
+            ("n", trx_count)("a", allocations)("p", double(allocations) / trx_count) );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
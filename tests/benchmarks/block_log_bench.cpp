@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/block_database.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( block_log_bench, database_fixture )
+
+/**
+ *  Produces a chain of blocks full of transfers, then stores it in a plain and in a compressed block log and
+ *  reports the size of each and how fast a database replays from it.
+ */
+BOOST_AUTO_TEST_CASE( compressed_replay )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 5000;
+#else
+      const uint32_t block_count = 500;
+#endif
+      const uint32_t transfers_per_block = 20;
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_transaction_dupe_check |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      ACTORS((alice)(bob));
+      transfer( account_id_type(), alice_id, asset( 100000000 ) );
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         for( uint32_t j = 0; j < transfers_per_block; ++j )
+            transfer( i % 2 ? bob_id : alice_id, i % 2 ? alice_id : bob_id, asset( 1 + j ) );
+         generate_block();
+      }
+
+      vector<signed_block> blocks;
+      for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+         blocks.push_back( *db.fetch_block_by_number( num ) );
+
+      for( bool compress : { false, true } )
+      {
+         fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+         {
+            database replica;
+            replica.set_compress_block_log( compress );
+            replica.open( dir.path(), [this]{ return genesis_state; } );
+            for( const auto& b : blocks )
+               replica.push_block( b, skip );
+            replica.close();
+         }
+
+         const fc::path log_dir = dir.path() / "database" / "block_num_to_block";
+         uint64_t log_size = 0;
+         for( const char* name : { "blocks", "tail", "chunks", "chunk_index" } )
+            if( fc::exists( log_dir / name ) )
+               log_size += fc::file_size( log_dir / name );
+
+         database replica;
+         replica.set_compress_block_log( compress );
+         auto start = fc::time_point::now();
+         replica.reindex( dir.path(), genesis_state );
+         auto elapsed = fc::time_point::now() - start;
+         BOOST_CHECK( replica.head_block_id() == db.head_block_id() );
+
+         ilog( "${f} block log: ${s} bytes for ${n} blocks; replayed in ${t} ms (${r} blocks/sec)",
+               ("f", compress ? "compressed" : "plain")("s", log_size)("n", blocks.size())
+               ("t", elapsed.count() / 1000)
+               ("r", elapsed.count() ? uint64_t( blocks.size() ) * 1000000 / elapsed.count() : 0) );
+         replica.close();
+      }
+
+      // raw block data against the same blocks compressed
+      fc::temp_directory plain_dir( graphene::utilities::temp_directory_path() ),
+                         compressed_dir( graphene::utilities::temp_directory_path() );
+      block_database plain, compressed;
+      plain.open( plain_dir.path() );
+      compressed.open( compressed_dir.path(), true );
+      for( const auto& b : blocks )
+      {
+         plain.store( b.id(), b );
+         compressed.store( b.id(), b );
+      }
+      uint64_t plain_size = fc::file_size( plain_dir.path() / "blocks" );
+      uint64_t compressed_size = fc::file_size( compressed_dir.path() / "chunks" ) +
+                                 fc::file_size( compressed_dir.path() / "tail" );
+      ilog( "Compression ratio: ${r}% (${c} of ${p} bytes)",
+            ("r", plain_size ? compressed_size * 100 / plain_size : 0)("c", compressed_size)("p", plain_size) );
+      BOOST_CHECK( compressed_size < plain_size );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Replays the same chain of blocks full of transfers with different numbers of threads reading blocks ahead, with
+ *  and without verifying witness signatures, and reports how fast each replay runs.
+ */
+BOOST_AUTO_TEST_CASE( pipelined_replay )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 5000;
+#else
+      const uint32_t block_count = 500;
+#endif
+      const uint32_t transfers_per_block = 20;
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_transaction_dupe_check |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      ACTORS((alice)(bob));
+      transfer( account_id_type(), alice_id, asset( 100000000 ) );
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         for( uint32_t j = 0; j < transfers_per_block; ++j )
+            transfer( i % 2 ? bob_id : alice_id, i % 2 ? alice_id : bob_id, asset( 1 + j ) );
+         generate_block();
+      }
+
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      {
+         database replica;
+         replica.open( dir.path(), [this]{ return genesis_state; } );
+         for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+            replica.push_block( *db.fetch_block_by_number( num ), skip );
+         replica.close();
+      }
+
+      for( uint32_t threads : { 0, 1, 2, 4 } )
+      {
+         for( bool verify : { false, true } )
+         {
+            database replica;
+            replica.set_replay_thread_count( threads );
+            replica.set_replay_verify_signatures( verify );
+            auto start = fc::time_point::now();
+            replica.reindex( dir.path(), genesis_state );
+            auto elapsed = fc::time_point::now() - start;
+            BOOST_CHECK( replica.head_block_id() == db.head_block_id() );
+
+            ilog( "Replayed ${n} blocks with ${t} reader threads${v} in ${ms} ms (${r} blocks/sec)",
+                  ("n", db.head_block_num())("t", threads)("v", verify ? ", verifying signatures," : "")
+                  ("ms", elapsed.count() / 1000)
+                  ("r", elapsed.count() ? uint64_t( db.head_block_num() ) * 1000000 / elapsed.count() : 0) );
+            replica.close();
+         }
+      }
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Stores a chain of blocks full of transfers with a state checkpoint close to its head, abandons the database as a
+ *  killed node would, and reports how long restarting from the checkpoint takes against replaying every block.
+ */
+BOOST_AUTO_TEST_CASE( checkpoint_restart )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 5000;
+#else
+      const uint32_t block_count = 500;
+#endif
+      const uint32_t transfers_per_block = 20;
+      const uint32_t checkpoint_interval = block_count / 5;
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_transaction_dupe_check |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      ACTORS((alice)(bob));
+      transfer( account_id_type(), alice_id, asset( 100000000 ) );
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         for( uint32_t j = 0; j < transfers_per_block; ++j )
+            transfer( i % 2 ? bob_id : alice_id, i % 2 ? alice_id : bob_id, asset( 1 + j ) );
+         generate_block();
+      }
+
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      {
+         // never closed, so only the checkpoints hold any state
+         database replica;
+         replica.set_state_checkpoint_interval( checkpoint_interval );
+         replica.open( dir.path(), [this]{ return genesis_state; } );
+         for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+            replica.push_block( *db.fetch_block_by_number( num ), skip );
+      }
+
+      // only irreversible blocks had reached the block log, so both restarts stop short of the producer's head
+      block_id_type restored_head;
+      for( bool from_checkpoint : { true, false } )
+      {
+         database replica;
+         auto start = fc::time_point::now();
+         if( from_checkpoint )
+            replica.reindex_from_checkpoint( dir.path(), genesis_state );
+         else
+            replica.reindex( dir.path(), genesis_state );
+         auto elapsed = fc::time_point::now() - start;
+         if( from_checkpoint )
+            restored_head = replica.head_block_id();
+         BOOST_CHECK( replica.head_block_id() == restored_head );
+
+         ilog( "Restarted at block ${n} ${how} in ${ms} ms",
+               ("n", replica.head_block_num())
+               ("how", from_checkpoint ? "from a state checkpoint" : "by replaying every block")
+               ("ms", elapsed.count() / 1000) );
+         replica.close();
+      }
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_evaluator.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( expiry_bench, database_fixture )
+
+/**
+ *  Places many limit orders from a few hundred accounts which all expire at the same round timestamp, and reports
+ *  how long the block which cancels them takes to apply.
+ */
+BOOST_AUTO_TEST_CASE( simultaneous_limit_order_expirations )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t order_count = 100000;
+#else
+      const uint32_t order_count = 2000;
+#endif
+      const uint32_t account_count = 200;
+
+      const auto& test = create_user_issued_asset("UIATEST");
+      vector<account_id_type> sellers;
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         sellers.push_back( create_account( "seller" + fc::to_string(i) ).id );
+         transfer( account_id_type(), sellers.back(), asset( 1000 * order_count / account_count ) );
+      }
+      generate_block();
+
+      // bots commonly expire their orders on the minute
+      auto expiration = db.head_block_time() + fc::minutes(20);
+      expiration = fc::time_point_sec( expiration.sec_since_epoch() - expiration.sec_since_epoch() % 60 );
+
+      for( uint32_t i = 0; i < order_count; ++i )
+      {
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         limit_order_create_operation op;
+         op.seller = sellers[i % account_count];
+         op.amount_to_sell = asset( 100 );
+         op.min_to_receive = test.amount( 1000 + i );
+         op.expiration = expiration;
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+         if( i % 1000 == 999 )
+            generate_block();
+      }
+      generate_blocks( expiration - fc::seconds( db.get_global_properties().parameters.block_interval ) );
+      BOOST_REQUIRE_EQUAL( db.get_index_type<limit_order_index>().indices().size(), order_count );
+
+      auto start = fc::time_point::now();
+      generate_block();
+      auto elapsed = fc::time_point::now() - start;
+
+      ilog( "Expired ${n} limit orders in one block in ${t} ms", ("n", order_count)("t", elapsed.count() / 1000) );
+      BOOST_CHECK( db.get_index_type<limit_order_index>().indices().empty() );
+      for( auto seller : sellers )
+         BOOST_CHECK_EQUAL( seller(db).statistics(db).total_core_in_orders.value, 0 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -17,6 +17,7 @@
  */
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/transaction_prevalidator.hpp>
 #include <graphene/utilities/tempdir.hpp>
 
 #include <graphene/time/time.hpp>
@@ -55,20 +56,29 @@ BOOST_AUTO_TEST_CASE( genesis_and_persistence_bench )
       const int blocks_to_produce = 1000;
 #endif
 
-      for( int i = 0; i < account_count; ++i )
-         genesis_state.initial_accounts.emplace_back("target"+fc::to_string(i),
-                                                     public_key_type(fc::ecc::private_key::regenerate(fc::digest(i)).get_public_key()));
+      // deriving the public keys dominates building the genesis state, so it is spread over a few threads
+      worker_pool workers( "genesis" );
+      workers.set_thread_count( 3 );
+      genesis_state.initial_accounts.resize( account_count );
+      workers.run_sharded( account_count, [&]( size_t, size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            genesis_state.initial_accounts[i] = genesis_state_type::initial_account_type( "target"+fc::to_string(uint64_t(i)),
+                                                     public_key_type(fc::ecc::private_key::regenerate(fc::digest(int(i))).get_public_key()));
+      });
 
       fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
 
       {
          database db;
+         fc::time_point start_time = fc::time_point::now();
          db.open(data_dir.path(), [&]{return genesis_state;});
+         ilog("Initialized genesis with ${n} accounts in ${t} milliseconds.",
+              ("n", account_count)("t", (fc::time_point::now() - start_time).count() / 1000));
 
          for( int i = 11; i < account_count + 11; ++i)
             BOOST_CHECK(db.get_balance(account_id_type(i), asset_id_type()).amount == GRAPHENE_MAX_SHARE_SUPPLY / account_count);
 
-         fc::time_point start_time = fc::time_point::now();
+         start_time = fc::time_point::now();
          db.close();
          ilog("Closed database in ${t} milliseconds.", ("t", (fc::time_point::now() - start_time).count() / 1000));
       }
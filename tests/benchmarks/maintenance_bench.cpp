@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( maintenance_bench, database_fixture )
+
+/**
+ *  Registers many voting accounts, then applies the same maintenance block with and without worker threads and
+ *  reports how long the maintenance took.  The elected witnesses and committee members must not depend on the
+ *  number of threads.
+ */
+BOOST_AUTO_TEST_CASE( vote_tally )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t account_count = 50000;
+#else
+      const uint32_t account_count = 1000;
+#endif
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_transaction_dupe_check |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      vector<vote_id_type> candidates;
+      for( const witness_object& w : db.get_index_type<witness_index>().indices() )
+         candidates.push_back( w.vote_id );
+      for( const committee_member_object& c : db.get_index_type<committee_member_index>().indices() )
+         candidates.push_back( c.vote_id );
+
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         const account_object& voter = create_account( "voter" + fc::to_string( uint64_t(i) ) );
+         transfer( account_id_type(), voter.id, asset( 1000 + i ) );
+
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         account_update_operation op;
+         op.account = voter.id;
+         op.new_options = voter.options;
+         op.new_options->votes.insert( candidates[i % candidates.size()] );
+         op.new_options->votes.insert( candidates[(i * 7) % candidates.size()] );
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+         if( i % 500 == 499 )
+            generate_block();
+      }
+      // the next block is the first of the new maintenance interval
+      generate_blocks( fc::time_point_sec( db.get_dynamic_global_properties().next_maintenance_time -
+                                           fc::seconds( db.get_global_properties().parameters.block_interval ) ) );
+
+      signed_block b = generate_block( skip );
+      const auto expected_witnesses = db.get_global_properties().active_witnesses;
+      const auto expected_committee = db.get_global_properties().active_committee_members;
+
+      for( uint32_t threads : { 0, 1, 4 } )
+      {
+         db.set_prevalidation_thread_count( threads );
+         db.pop_block();
+         db.push_block( b, skip );
+
+         BOOST_CHECK( db.get_global_properties().active_witnesses == expected_witnesses );
+         BOOST_CHECK( db.get_global_properties().active_committee_members == expected_committee );
+         ilog( "${threads} worker threads: maintenance over ${n} accounts took ${t} ms",
+               ("threads", threads)("n", db.get_index_type<account_index>().indices().size())
+               ("t", db.get_last_maintenance_duration().count() / 1000) );
+      }
+      db.set_prevalidation_thread_count( 0 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_evaluator.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( market_bench, database_fixture )
+
+/**
+ *  Places non-crossing limit orders on both sides of a BITUSD/CORE market which has open margin positions, and
+ *  reports the number of orders per second the database accepts.  None of the orders is priced to trigger a
+ *  margin call, which is the common case the margin call trigger index is meant to make cheap.
+ */
+BOOST_AUTO_TEST_CASE( limit_orders_per_second )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t order_count = 50000;
+#else
+      const uint32_t order_count = 2000;
+#endif
+      ACTORS((buyer)(seller)(borrower)(feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+
+      transfer(committee_account, buyer_id, asset(100000000));
+      transfer(committee_account, borrower_id, asset(100000000));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      borrow( borrower, bitusd.amount(10000000), asset(40000000) );
+      transfer( borrower_id, seller_id, bitusd.amount(10000000) );
+      generate_block();
+
+      auto place = [&]( account_id_type who, const asset& sell, const asset& receive )
+      {
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         limit_order_create_operation op;
+         op.seller = who;
+         op.amount_to_sell = sell;
+         op.min_to_receive = receive;
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+      };
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < order_count; ++i )
+      {
+         // bids for BITUSD well below the feed, and asks far above the short squeeze price
+         if( i % 2 )
+            place( buyer_id, core.amount( 100 ), bitusd.amount( 200 + i % 50 ) );
+         else
+            place( seller_id, bitusd.amount( 100 ), core.amount( 300 + i % 50 ) );
+         if( i % 1000 == 999 )
+            generate_block();
+      }
+      auto elapsed = fc::time_point::now() - start;
+      generate_block();
+
+      ilog( "Placed ${n} limit orders in ${t} ms (${r} orders/sec)",
+            ("n", order_count)("t", elapsed.count() / 1000)
+            ("r", elapsed.count() ? uint64_t(order_count) * 1000000 / elapsed.count() : 0) );
+      BOOST_CHECK( db.get_index_type<call_order_index>().indices().size() == 1 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Fills a deep book of resting asks spread over many price levels with crossing bids, each of which consumes
+ *  several resting orders, and reports the number of resting orders matched per second.
+ */
+BOOST_AUTO_TEST_CASE( matched_orders_per_second )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t order_count = 50000;
+#else
+      const uint32_t order_count = 2000;
+#endif
+      const uint32_t orders_per_bid = 10;
+      ACTORS((buyer)(seller));
+
+      const auto& test = create_user_issued_asset("UIATEST");
+      const auto& core = asset_id_type()(db);
+
+      issue_uia( seller, test.amount( 100 * order_count ) );
+      transfer( committee_account, buyer_id, asset( 1000 * order_count ) );
+      generate_block();
+
+      auto place = [&]( account_id_type who, const asset& sell, const asset& receive )
+      {
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         limit_order_create_operation op;
+         op.seller = who;
+         op.amount_to_sell = sell;
+         op.min_to_receive = receive;
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+      };
+
+      for( uint32_t i = 0; i < order_count; ++i )
+      {
+         place( seller_id, test.amount( 100 ), core.amount( 100 + i % 500 ) );
+         if( i % 1000 == 999 )
+            generate_block();
+      }
+      generate_block();
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < order_count / orders_per_bid; ++i )
+      {
+         // priced above every ask, so each bid is filled by the best resting orders
+         place( buyer_id, core.amount( 600 * orders_per_bid ), test.amount( 100 * orders_per_bid ) );
+         if( i % 100 == 99 )
+            generate_block();
+      }
+      auto elapsed = fc::time_point::now() - start;
+      generate_block();
+
+      ilog( "Matched ${n} resting limit orders in ${t} ms (${r} orders/sec)",
+            ("n", order_count)("t", elapsed.count() / 1000)
+            ("r", elapsed.count() ? uint64_t(order_count) * 1000000 / elapsed.count() : 0) );
+      // every ask has been filled; the last few bids may be left resting
+      const auto& by_price_idx = db.get_index_type<limit_order_index>().indices().get<by_price>();
+      BOOST_CHECK( by_price_idx.lower_bound( price::max( test.id, core.id ) ) ==
+                   by_price_idx.upper_bound( price::min( test.id, core.id ) ) );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
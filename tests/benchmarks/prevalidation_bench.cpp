@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Cryptonomex, Inc.
+ * All rights reserved.
+ *
+ * This source code is provided for evaluation in private test networks only, until September 8, 2015. After this date, this license expires and
+ * the code may not be used, modified or distributed for any purpose. Redistribution and use in source and binary forms, with or without modification,
+ * are permitted until September 8, 2015, provided that the following conditions are met:
+ *
+ * 1. The code and/or derivative works are used only for private test networks consisting of no more than 10 P2P nodes.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/transaction_prevalidator.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( prevalidation_bench, database_fixture )
+
+/**
+ *  Builds a block of single-transfer transactions and applies it with different numbers of prevalidation threads,
+ *  reporting how long each apply took.  Evaluation stays in block order, so the resulting balances must be the
+ *  same whatever the number of threads.
+ */
+BOOST_AUTO_TEST_CASE( prevalidation_threads )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t trx_count = 4000;
+#else
+      const uint32_t trx_count = 400;
+#endif
+      const uint32_t skip = database::skip_witness_signature |
+                            database::skip_transaction_signatures |
+                            database::skip_transaction_dupe_check |
+                            database::skip_fork_db |
+                            database::skip_tapos_check |
+                            database::skip_authority_check |
+                            database::skip_undo_history_check;
+
+      vector<account_id_type> accounts;
+      for( uint32_t i = 0; i < 2 * trx_count; ++i )
+      {
+         accounts.push_back( create_account( "bench" + fc::to_string( uint64_t(i) ) ).id );
+         if( i % 200 == 199 ) generate_block();
+      }
+      generate_block();
+      for( uint32_t i = 0; i < accounts.size(); ++i )
+      {
+         transfer( account_id_type(), accounts[i], asset(1000) );
+         if( i % 200 == 199 ) generate_block();
+      }
+      generate_block();
+
+      for( uint32_t i = 0; i < trx_count; ++i )
+      {
+         signed_transaction t;
+         t.set_expiration( db.head_block_time() + fc::minutes(1) );
+         transfer_operation op;
+         op.from   = accounts[2*i];
+         op.to     = accounts[2*i+1];
+         op.amount = asset(1);
+         t.operations.push_back( op );
+         db.push_transaction( t, ~0 );
+      }
+      signed_block b = generate_block( ~0 );
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), trx_count );
+
+      vector<asset> sequential_balances;
+      for( auto id : accounts )
+         sequential_balances.push_back( db.get_balance( id, asset_id_type() ) );
+
+      for( uint32_t threads : { 0, 2, 4 } )
+      {
+         db.set_prevalidation_thread_count( threads );
+         db.pop_block();
+         auto start = fc::time_point::now();
+         db.push_block( b, skip );
+         auto elapsed = fc::time_point::now() - start;
+
+         for( uint32_t i = 0; i < accounts.size(); ++i )
+            BOOST_CHECK( db.get_balance( accounts[i], asset_id_type() ) == sequential_balances[i] );
+         ilog( "${threads} prevalidation threads: applied ${n} transactions in ${t} us",
+               ("threads", threads)("n", trx_count)("t", elapsed.count()) );
+      }
+      db.set_prevalidation_thread_count( 0 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -26,9 +26,12 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/vote_tally_index.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 #include "../common/database_fixture.hpp"
 
@@ -1085,4 +1088,131 @@ BOOST_FIXTURE_TEST_CASE( voting_account, database_fixture )
                          vikram_committee_member) != db.get_global_properties().active_committee_members.end());
 } FC_LOG_AND_RETHROW() }
 
+/**
+ *  Moves stake between balances, orders and voting accounts, including through an undone block, and checks the
+ *  committee elected from the running vote totals.  Debug builds also check the totals against a full tally at
+ *  every maintenance interval.
+ */
+BOOST_FIXTURE_TEST_CASE( running_vote_totals, database_fixture )
+{ try {
+   ACTORS((nathan)(vikram));
+   upgrade_to_lifetime_member(nathan_id);
+   upgrade_to_lifetime_member(vikram_id);
+   committee_member_id_type nathan_committee_member = create_committee_member(nathan_id(db)).id;
+   committee_member_id_type vikram_committee_member = create_committee_member(vikram_id(db)).id;
+   const auto& test = create_user_issued_asset("UIATEST");
+   generate_block();
+
+   transfer(account_id_type(), nathan_id, asset(1000000));
+   transfer(account_id_type(), vikram_id, asset(100));
+
+   auto vote = [&]( account_id_type voter, account_id_type voting_account, committee_member_id_type member,
+                    const fc::ecc::private_key& key )
+   {
+      account_update_operation op;
+      op.account = voter;
+      op.new_options = voter(db).options;
+      op.new_options->voting_account = voting_account;
+      op.new_options->votes = flat_set<vote_id_type>{member(db).vote_id};
+      op.new_options->num_committee = 1;
+      trx.operations.push_back(op);
+      trx.sign(key);
+      PUSH_TX( db, trx );
+      trx.clear();
+   };
+   auto is_active = [&]( committee_member_id_type member )
+   {
+      const auto& active = db.get_global_properties().active_committee_members;
+      return std::find(active.begin(), active.end(), member) != active.end();
+   };
+
+   // nathan's stake votes with vikram's opinions
+   vote(vikram_id, account_id_type(), vikram_committee_member, vikram_private_key);
+   vote(nathan_id, vikram_id, nathan_committee_member, nathan_private_key);
+   generate_block();
+
+   // an undone change of voting account must leave the totals as they were
+   vote(nathan_id, account_id_type(), nathan_committee_member, nathan_private_key);
+   generate_block();
+   db.pop_block();
+   trx.clear();
+
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time + GRAPHENE_DEFAULT_BLOCK_INTERVAL);
+   BOOST_CHECK(!is_active(nathan_committee_member));
+   BOOST_CHECK(is_active(vikram_committee_member));
+
+   // stake in orders still votes; vikram's opinion now follows nathan's own
+   BOOST_REQUIRE(create_sell_order(nathan_id(db), asset(900000), test.amount(100)) != nullptr);
+   vote(nathan_id, account_id_type(), nathan_committee_member, nathan_private_key);
+   vote(vikram_id, nathan_id, vikram_committee_member, vikram_private_key);
+
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time + GRAPHENE_DEFAULT_BLOCK_INTERVAL);
+   BOOST_CHECK(is_active(nathan_committee_member));
+} FC_LOG_AND_RETHROW() }
+
+/**
+ *  Reopens a saved database and checks that the vote totals rebuilt while loading equal the running totals of the
+ *  database they were saved from.
+ */
+BOOST_FIXTURE_TEST_CASE( vote_totals_after_reopen, database_fixture )
+{ try {
+   ACTORS((nathan)(vikram));
+   upgrade_to_lifetime_member(nathan_id);
+   committee_member_id_type nathan_committee_member = create_committee_member(nathan_id(db)).id;
+   const auto& test = create_user_issued_asset("UIATEST");
+   generate_block();
+
+   transfer(account_id_type(), nathan_id, asset(1000000));
+   transfer(account_id_type(), vikram_id, asset(1000));
+
+   account_update_operation op;
+   op.account = vikram_id;
+   op.new_options = vikram_id(db).options;
+   op.new_options->voting_account = nathan_id;
+   trx.operations.push_back(op);
+   op.account = nathan_id;
+   op.new_options = nathan_id(db).options;
+   op.new_options->votes = flat_set<vote_id_type>{nathan_committee_member(db).vote_id};
+   op.new_options->num_committee = 1;
+   trx.operations.push_back(op);
+   trx.sign(vikram_private_key);
+   trx.sign(nathan_private_key);
+   PUSH_TX( db, trx );
+   trx.clear();
+   BOOST_REQUIRE(create_sell_order(nathan_id(db), asset(500000), test.amount(100)) != nullptr);
+   generate_block();
+
+   fc::temp_directory reopened_dir( graphene::utilities::temp_directory_path() );
+   db.save( reopened_dir.path() );
+   database reopened;
+   reopened.open( reopened_dir.path(), [this]{ return genesis_state; } );
+
+   auto totals = []( const database& d ) -> const vote_totals& {
+      return dynamic_cast<const primary_index<account_index>&>( d.get_index_type<account_index>() )
+                .get_secondary_index<vote_tally_index>().totals();
+   };
+   // entries which dropped to zero may be left in the running totals, so only non-zero stake is compared
+   auto same_stake = []( const flat_map<uint16_t,uint64_t>& a, const flat_map<uint16_t,uint64_t>& b ) {
+      for( const auto& item : a )
+         if( item.second != (b.count(item.first) ? b.at(item.first) : 0) )
+            return false;
+      for( const auto& item : b )
+         if( item.second != (a.count(item.first) ? a.at(item.first) : 0) )
+            return false;
+      return true;
+   };
+   const vote_totals& running = totals( db );
+   const vote_totals& rebuilt = totals( reopened );
+   for( size_t i = 0; i < std::max( running.votes.size(), rebuilt.votes.size() ); ++i )
+      BOOST_CHECK_EQUAL( i < running.votes.size() ? running.votes[i] : 0,
+                         i < rebuilt.votes.size() ? rebuilt.votes[i] : 0 );
+   BOOST_CHECK( same_stake( running.witness_count_stake, rebuilt.witness_count_stake ) );
+   BOOST_CHECK( same_stake( running.committee_count_stake, rebuilt.committee_count_stake ) );
+
+   // vikram's stake and nathan's stake in orders both count for nathan's committee member
+   vote_id_type nathan_vote = nathan_committee_member(db).vote_id;
+   BOOST_REQUIRE_GT( rebuilt.votes.size(), nathan_vote.instance() );
+   BOOST_CHECK_GT( rebuilt.votes[nathan_vote.instance()], 500000u );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -24,11 +24,13 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_evaluator.hpp>
+#include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/thread/thread.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -117,6 +119,271 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_reads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), 0 );
+      BOOST_CHECK( bdb.fetch_block_ids( 1, 10 ).empty() );
+
+      vector<block_id_type> ids;
+      signed_block b;
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), 100 );
+
+      auto fetched = bdb.fetch_block_ids( 11, 20 );
+      BOOST_REQUIRE_EQUAL( fetched.size(), 20 );
+      for( uint32_t i = 0; i < 20; ++i )
+         BOOST_CHECK( fetched[i] == ids[10+i] );
+      BOOST_CHECK_EQUAL( bdb.fetch_block_ids( 91, 20 ).size(), 10 );
+
+      // readers on other threads see every stored block while more are being stored
+      fc::thread reader( "block_reader" );
+      auto done = reader.async( [&]() {
+         for( uint32_t n = 0; n < 10; ++n )
+            for( uint32_t i = 1; i <= 100; ++i )
+            {
+               auto blk = bdb.fetch_by_number( i );
+               FC_ASSERT( blk.valid() && blk->id() == ids[i-1] );
+            }
+      } );
+      signed_block later = b;
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         later.previous = later.id();
+         bdb.store( later.id(), later );
+      }
+      done.wait();
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), 200 );
+
+      // removing the head makes the highest remaining block the head, also after reopening
+      for( uint32_t i = 0; i < 100; ++i )
+         bdb.remove( bdb.fetch_block_id( bdb.last_block_num() ) );
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), 100 );
+      BOOST_CHECK( !bdb.contains( later.id() ) );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), 100 );
+      BOOST_REQUIRE( bdb.last().valid() );
+      BOOST_CHECK( bdb.last()->id() == b.id() );
+      BOOST_CHECK_EQUAL( bdb.fetch_block_ids( 91, 20 ).size(), 10 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_headers )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> blocks;
+      signed_block b;
+      for( uint32_t i = 0; i < 20; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.transactions.resize( i % 3 );
+         bdb.store( b.id(), b );
+         blocks.push_back( b );
+      }
+
+      auto check_headers = [&]( uint32_t count ) {
+         for( uint32_t num = 1; num <= count; ++num )
+         {
+            auto h = bdb.fetch_header_by_number( num );
+            BOOST_REQUIRE( h.valid() );
+            BOOST_CHECK( h->block_id == blocks[num-1].id() );
+            BOOST_CHECK( h->id() == blocks[num-1].id() );
+            BOOST_CHECK( h->witness == blocks[num-1].witness );
+            BOOST_CHECK_EQUAL( h->transaction_count, blocks[num-1].transactions.size() );
+         }
+         auto range = bdb.fetch_headers( 5, 100 );
+         BOOST_REQUIRE_EQUAL( range.size(), count - 4 );
+         for( uint32_t i = 0; i < range.size(); ++i )
+            BOOST_CHECK( range[i].block_id == blocks[4+i].id() );
+      };
+      check_headers( 20 );
+
+      bdb.remove( blocks[19].id() );
+      BOOST_CHECK( !bdb.fetch_header_by_number( 20 ).valid() );
+      check_headers( 19 );
+
+      // a block log without headers gets them when it is opened
+      bdb.close();
+      fc::remove( data_dir.path() / "headers" );
+      bdb.open( data_dir.path() );
+      check_headers( 19 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( compressed_block_database )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const uint32_t block_count = block_database::blocks_per_chunk * 3 + 10;
+
+      block_database bdb;
+      bdb.open( data_dir.path(), true );
+      BOOST_CHECK( bdb.is_compressed() );
+      bdb.set_chunk_cache_size( 1 );
+
+      vector<block_id_type> ids;
+      signed_block b;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), block_count );
+
+      // blocks are read back from every chunk and from the tail, in and out of order
+      auto check_all = [&]() {
+         for( uint32_t num = bdb.last_block_num(); num > 0; num = num > 7 ? num - 7 : 0 )
+         {
+            auto blk = bdb.fetch_by_number( num );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[num-1] );
+            BOOST_CHECK( blk->witness == witness_id_type(num) );
+         }
+         for( uint32_t num = 1; num <= bdb.last_block_num(); ++num )
+            BOOST_CHECK( bdb.fetch_optional( ids[num-1] ).valid() );
+      };
+      check_all();
+
+      // an existing block log keeps its format
+      bdb.close();
+      bdb.open( data_dir.path(), false );
+      BOOST_CHECK( bdb.is_compressed() );
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), block_count );
+      check_all();
+
+      // removing blocks from the end reopens the last chunk
+      while( bdb.last_block_num() > block_database::blocks_per_chunk * 2 - 5 )
+         bdb.remove( ids[bdb.last_block_num()-1] );
+      BOOST_CHECK( !bdb.contains( ids[block_database::blocks_per_chunk * 2] ) );
+      check_all();
+
+      // and storing them again seals it again
+      for( uint32_t num = bdb.last_block_num() + 1; num <= block_count; ++num )
+      {
+         auto blk = signed_block();
+         blk.previous = ids[num-2];
+         blk.witness = witness_id_type(num);
+         bdb.store( blk.id(), blk );
+         BOOST_CHECK( blk.id() == ids[num-1] );
+      }
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( bdb.last_block_num(), block_count );
+      check_all();
+
+      // only the end of a compressed block log can change
+      GRAPHENE_CHECK_THROW( bdb.remove( ids[10] ), fc::exception );
+      GRAPHENE_CHECK_THROW( bdb.store( ids[10], *bdb.fetch_by_number( 11 ) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pruned_block_database )
+{
+   try {
+      for( bool compress : { false, true } )
+      {
+         fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+         const uint32_t block_count = block_database::blocks_per_chunk * 3 + 10;
+         const uint32_t retain = 300;
+
+         block_database bdb;
+         bdb.open( data_dir.path(), compress );
+         bdb.set_retain_blocks( retain );
+
+         vector<block_id_type> ids;
+         signed_block b;
+         for( uint32_t i = 0; i < block_count; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+
+         // blocks are pruned a chunk at a time, and at least the requested number is kept
+         auto check_pruned = [&]() {
+            const uint32_t first = bdb.first_block_num();
+            BOOST_CHECK_EQUAL( first, block_database::blocks_per_chunk + 1 );
+            BOOST_CHECK_EQUAL( bdb.last_block_num(), block_count );
+            BOOST_CHECK_GE( bdb.last_block_num() - first + 1, retain );
+            for( uint32_t num = 1; num < first; num += 17 )
+            {
+               BOOST_CHECK( !bdb.contains( ids[num-1] ) );
+               BOOST_CHECK( !bdb.fetch_by_number( num ).valid() );
+               BOOST_CHECK( !bdb.fetch_header_by_number( num ).valid() );
+            }
+            BOOST_CHECK( bdb.fetch_block_ids( 1, 10 ).empty() );
+            BOOST_CHECK( bdb.fetch_headers( first - 1, 10 ).empty() );
+            for( uint32_t num = first; num <= bdb.last_block_num(); ++num )
+            {
+               auto blk = bdb.fetch_by_number( num );
+               BOOST_REQUIRE( blk.valid() );
+               BOOST_CHECK( blk->id() == ids[num-1] );
+            }
+            BOOST_CHECK_EQUAL( bdb.fetch_block_ids( first, block_count ).size(), block_count - first + 1 );
+            BOOST_CHECK_EQUAL( bdb.fetch_headers( first, block_count ).size(), block_count - first + 1 );
+         };
+         check_pruned();
+
+         // the first retained block is found again from the index
+         bdb.close();
+         bdb.open( data_dir.path() );
+         check_pruned();
+
+         // a copy in the other format begins at the same block, as convert_block_log makes it
+         fc::temp_directory copy_dir( graphene::utilities::temp_directory_path() );
+         block_database copy;
+         copy.open( copy_dir.path(), !compress );
+         copy.start_at( bdb.first_block_num() );
+         for( uint32_t num = bdb.first_block_num(); num <= bdb.last_block_num(); ++num )
+            copy.store( ids[num-1], *bdb.fetch_by_number( num ) );
+         copy.close();
+         copy.open( copy_dir.path() );
+         BOOST_CHECK_EQUAL( copy.is_compressed(), !compress );
+         BOOST_CHECK_EQUAL( copy.first_block_num(), bdb.first_block_num() );
+         BOOST_CHECK_EQUAL( copy.last_block_num(), block_count );
+         BOOST_CHECK( !copy.fetch_by_number( bdb.first_block_num() - 1 ).valid() );
+         for( uint32_t num = bdb.first_block_num(); num <= block_count; ++num )
+         {
+            auto blk = copy.fetch_by_number( num );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[num-1] );
+         }
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -165,6 +432,184 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( last_irreversible_block )
+{
+   try {
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         const uint32_t witness_count = db.get_global_properties().active_witnesses.size();
+         BOOST_CHECK_EQUAL( db.last_irreversible_block_num(), 0 );
+
+         for( uint32_t i = 0; i < 3 * witness_count; ++i )
+         {
+            now += db.block_interval();
+            db.generate_block( now, db.get_scheduled_witness( 1 ).first, init_account_priv_key, database::skip_nothing );
+         }
+
+         // every witness produces once per round, so only blocks of the last two rounds can be reversible
+         const uint32_t lib = db.last_irreversible_block_num();
+         BOOST_CHECK( lib > 0 );
+         BOOST_CHECK( lib < db.head_block_num() );
+         BOOST_CHECK( db.head_block_num() - lib < 2 * witness_count );
+
+         // reversible blocks are served from memory, irreversible ones from the block log
+         auto headers = db.fetch_block_headers( 1, db.head_block_num() + 10 );
+         BOOST_REQUIRE_EQUAL( headers.size(), db.head_block_num() );
+         for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+         {
+            auto b = db.fetch_block_by_number( num );
+            BOOST_REQUIRE( b.valid() );
+            BOOST_CHECK( b->id() == db.get_block_id_for_num( num ) );
+            auto h = db.fetch_block_header_by_number( num );
+            BOOST_REQUIRE( h.valid() );
+            BOOST_CHECK( h->block_id == b->id() );
+            BOOST_CHECK( h->id() == b->id() );
+            BOOST_CHECK( headers[num-1].block_id == b->id() );
+         }
+         head_id = db.head_block_id();
+         db.close();
+      }
+      {
+         database db;
+         db.open(data_dir.path(), []{return genesis_state_type();});
+         BOOST_CHECK( db.head_block_id() == head_id );
+         auto b = db.fetch_block_by_number( db.head_block_num() );
+         BOOST_REQUIRE( b.valid() );
+         BOOST_CHECK( b->id() == head_id );
+
+         now = db.head_block_time() + db.block_interval();
+         db.generate_block( now, db.get_scheduled_witness( 1 ).first, init_account_priv_key, database::skip_nothing );
+         BOOST_CHECK( db.fetch_block_by_number( db.head_block_num() ).valid() );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pipelined_replay )
+{
+   try {
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         for( uint32_t i = 0; i < 50; ++i )
+         {
+            now += db.block_interval();
+            db.generate_block( now, db.get_scheduled_witness( 1 ).first, init_account_priv_key, database::skip_nothing );
+         }
+         head_id = db.head_block_id();
+         db.close();
+      }
+
+      // the same state results however many threads read ahead, and whether or not signatures are checked
+      for( uint32_t threads : { 0, 1, 3 } )
+      {
+         for( bool verify : { false, true } )
+         {
+            database db;
+            db.set_replay_thread_count( threads );
+            db.set_replay_verify_signatures( verify );
+            db.reindex( data_dir.path(), make_genesis() );
+            BOOST_CHECK( db.head_block_id() == head_id );
+            BOOST_CHECK_EQUAL( db.head_block_num(), 50 );
+            db.close();
+         }
+      }
+
+      // a block signed with the wrong key is only caught when signatures are checked
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         auto wrong_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("wrong_key")) );
+         now = db.head_block_time() + db.block_interval();
+         db.generate_block( now, db.get_scheduled_witness( 1 ).first, wrong_key, database::skip_witness_signature );
+         head_id = db.head_block_id();
+         db.close();
+      }
+      {
+         database db;
+         db.set_replay_thread_count( 2 );
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         db.close();
+      }
+      {
+         database db;
+         db.set_replay_thread_count( 2 );
+         db.set_replay_verify_signatures( true );
+         GRAPHENE_CHECK_THROW( db.reindex( data_dir.path(), make_genesis() ), fc::exception );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_checkpoint_restart )
+{
+   try {
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      const fc::path checkpoints = data_dir.path() / "checkpoints";
+      vector<block_id_type> ids;
+      block_id_type head_id;
+      {
+         // the database is destroyed without being closed, as if the node had been killed
+         database db;
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir.path(), make_genesis );
+         for( uint32_t i = 0; i < 35; ++i )
+         {
+            now += db.block_interval();
+            db.generate_block( now, db.get_scheduled_witness( 1 ).first, init_account_priv_key, database::skip_nothing );
+            ids.push_back( db.head_block_id() );
+         }
+      }
+      // each checkpoint replaces the one before
+      BOOST_CHECK( fc::exists( checkpoints / "30" / "checkpoint" ) );
+      BOOST_CHECK( !fc::exists( checkpoints / "20" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "object_database" ) );
+
+      {
+         database db;
+         db.reindex_from_checkpoint( data_dir.path(), make_genesis() );
+         // the state is restored at the checkpoint and brought up to whatever the block log holds after it; the
+         // reversible blocks after the checkpoint were lost with the process
+         BOOST_CHECK( db.head_block_num() >= 30 );
+         BOOST_CHECK( db.head_block_num() < 35 );
+         BOOST_CHECK( db.head_block_id() == ids[db.head_block_num() - 1] );
+         now = db.head_block_time() + db.block_interval();
+         db.generate_block( now, db.get_scheduled_witness( 1 ).first, init_account_priv_key, database::skip_nothing );
+         head_id = db.head_block_id();
+         db.close();
+      }
+
+      // a checkpoint which does not match the block log is skipped for a full replay
+      fc::json::save_to_file( fc::mutable_variant_object( "block_num", 30 )( "block_id", block_id_type() ),
+                              checkpoints / "30" / "checkpoint" );
+      {
+         database db;
+         db.reindex_from_checkpoint( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -394,6 +839,248 @@ BOOST_AUTO_TEST_CASE( switch_forks_undo_create )
    }
 }
 
+/**
+ *  db1 switches away from a fork which created an account and then back to it.  The blocks it had applied before are
+ *  replayed from their cached state changes and must leave db1 in the same state as a node which never left the fork.
+ */
+BOOST_AUTO_TEST_CASE( switch_back_to_popped_fork )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() ),
+                         dir3( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2,
+               db3;
+      db1.open(dir1.path(), make_genesis);
+      db2.open(dir2.path(), make_genesis);
+      db3.open(dir3.path(), make_genesis);
+
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      const graphene::db::index& account_idx = db1.get_index(protocol_ids, account_object_type);
+
+      signed_transaction trx;
+      trx.set_expiration(now + db1.get_global_properties().parameters.maximum_time_until_expiration);
+      account_id_type nathan_id = account_idx.get_next_id();
+      account_create_operation cop;
+      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+      cop.name = "nathan";
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      trx.operations.push_back(cop);
+      PUSH_TX( db1, trx );
+
+      // fork A: two blocks on db1 and db3, the first of which creates nathan
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db1.block_interval();
+         auto b = db1.generate_block(now, db1.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db3, b );
+      }
+      BOOST_CHECK(nathan_id(db1).name == "nathan");
+
+      // fork B: three blocks on db2, which db1 switches to
+      now = fc::time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         now += db2.block_interval();
+         auto b = db2.generate_block(now, db2.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db2.head_block_id().str());
+      GRAPHENE_CHECK_THROW(nathan_id(db1), fc::exception);
+
+      // fork A grows past fork B, so db1 switches back
+      now = db3.head_block_time();
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db3.block_interval();
+         auto b = db3.generate_block(now, db3.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db3.head_block_id().str());
+      BOOST_CHECK(nathan_id(db1).name == "nathan");
+      BOOST_CHECK(account_idx.get_next_id() == db3.get_index(protocol_ids, account_object_type).get_next_id());
+      BOOST_CHECK(db1.get_dynamic_global_properties().recently_missed_count == db3.get_dynamic_global_properties().recently_missed_count);
+      BOOST_CHECK(db1.get_scheduled_witness(1).first == db3.get_scheduled_witness(1).first);
+
+      // the replayed state undoes like any other
+      while( db1.head_block_num() > 0 )
+         db1.pop_block();
+      GRAPHENE_CHECK_THROW(nathan_id(db1), fc::exception);
+      BOOST_CHECK(account_idx.get_next_id() == nathan_id);
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Observers of applied_block must see every block of a fork switch, including the blocks switched back to, which are
+ *  replayed from their cached changes.
+ */
+BOOST_AUTO_TEST_CASE( switch_back_with_applied_block_observer )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() ),
+                         dir3( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2,
+               db3;
+      db1.open(dir1.path(), make_genesis);
+      db2.open(dir2.path(), make_genesis);
+      db3.open(dir3.path(), make_genesis);
+
+      vector<block_id_type> applied;
+      db1.applied_block.connect( [&]( const signed_block& b ){ applied.push_back( b.id() ); } );
+
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      // fork A: two blocks on db1 and db3
+      vector<block_id_type> fork_a;
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db1.block_interval();
+         auto b = db1.generate_block(now, db1.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db3, b );
+         fork_a.push_back( b.id() );
+      }
+
+      // fork B: three blocks on db2, which db1 switches to
+      now = fc::time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         now += db2.block_interval();
+         auto b = db2.generate_block(now, db2.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db2.head_block_id().str());
+      BOOST_CHECK_EQUAL( applied.size(), 5u );
+
+      // fork A grows past fork B, so db1 switches back and applies all of fork A again
+      now = db3.head_block_time();
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db3.block_interval();
+         auto b = db3.generate_block(now, db3.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+         fork_a.push_back( b.id() );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db3.head_block_id().str());
+      BOOST_REQUIRE_EQUAL( applied.size(), 9u );
+      BOOST_CHECK( vector<block_id_type>( applied.end() - 4, applied.end() ) == fork_a );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  db1 and db3 keep a history object for every applied operation, as the account history plugin does.  db1 switches
+ *  away from a fork which created an account and back to it, redoing the fork's blocks from their cached changes.  The
+ *  redone blocks emit their operations again and the history objects are created once, as on db3, which never left
+ *  the fork.
+ */
+BOOST_AUTO_TEST_CASE( redo_popped_block_with_applied_block_observer )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() ),
+                         dir3( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2,
+               db3;
+      for( database* db : { &db1, &db3 } )
+      {
+         db->add_index< primary_index< simple_index< operation_history_object > > >();
+         db->applied_block.connect( [db]( const signed_block& ){
+            for( const auto& op : db->get_applied_operations() )
+               db->create<operation_history_object>( [&]( operation_history_object& h ){
+                  h.op           = op.op;
+                  h.result       = op.result;
+                  h.block_num    = op.block_num;
+                  h.trx_in_block = op.trx_in_block;
+                  h.op_in_trx    = op.op_in_trx;
+                  h.virtual_op   = op.virtual_op;
+               });
+         });
+      }
+      db1.open(dir1.path(), make_genesis);
+      db2.open(dir2.path(), make_genesis);
+      db3.open(dir3.path(), make_genesis);
+
+      fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      const graphene::db::index& history_idx = db1.get_index(protocol_ids, operation_history_object_type);
+      const graphene::db::index& history_idx3 = db3.get_index(protocol_ids, operation_history_object_type);
+
+      signed_transaction trx;
+      trx.set_expiration(now + db1.get_global_properties().parameters.maximum_time_until_expiration);
+      account_id_type nathan_id = db1.get_index(protocol_ids, account_object_type).get_next_id();
+      account_create_operation cop;
+      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+      cop.name = "nathan";
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      trx.operations.push_back(cop);
+      PUSH_TX( db1, trx );
+
+      // fork A: two blocks on db1 and db3, the first of which creates nathan
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db1.block_interval();
+         auto b = db1.generate_block(now, db1.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db3, b );
+      }
+      BOOST_REQUIRE( history_idx.get_next_id().instance() > 0 );
+
+      // fork B: three blocks on db2, which db1 switches to
+      now = fc::time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         now += db2.block_interval();
+         auto b = db2.generate_block(now, db2.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db2.head_block_id().str());
+      GRAPHENE_CHECK_THROW(nathan_id(db1), fc::exception);
+      BOOST_CHECK_EQUAL(history_idx.get_next_id().instance(), 0u);
+
+      // fork A grows past fork B, so db1 switches back
+      now = db3.head_block_time();
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         now += db3.block_interval();
+         auto b = db3.generate_block(now, db3.get_scheduled_witness(1).first, init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db1, b );
+      }
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db3.head_block_id().str());
+      BOOST_CHECK(nathan_id(db1).name == "nathan");
+
+      const uint64_t history_count = history_idx.get_next_id().instance();
+      BOOST_REQUIRE_EQUAL(history_count, history_idx3.get_next_id().instance());
+      for( uint64_t i = 0; i < history_count; ++i )
+      {
+         const operation_history_object& h1 = operation_history_id_type(i)(db1);
+         const operation_history_object& h3 = operation_history_id_type(i)(db3);
+         BOOST_CHECK_EQUAL(h1.op.which(), h3.op.which());
+         BOOST_CHECK_EQUAL(h1.block_num, h3.block_num);
+         BOOST_CHECK_EQUAL(h1.trx_in_block, h3.trx_in_block);
+         BOOST_CHECK_EQUAL(h1.op_in_trx, h3.op_in_trx);
+         BOOST_CHECK_EQUAL(h1.virtual_op, h3.virtual_op);
+      }
+      BOOST_CHECK(operation_history_id_type()(db1).op.which() == operation::tag<account_create_operation>::value);
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( duplicate_transactions )
 {
    try {
@@ -597,6 +1284,96 @@ BOOST_FIXTURE_TEST_CASE( limit_order_expiration, database_fixture )
    BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 50000 );
 } FC_LOG_AND_RETHROW() }
 
+/**
+ *  Many orders expiring in the same block are canceled together; every seller must get each refund and every
+ *  order must still produce its cancel operation.  Call orders are checked after each cancel, while the orders
+ *  still to be canceled are on the book, so a call can fill against an order which expires in the same block.
+ */
+BOOST_FIXTURE_TEST_CASE( limit_order_bulk_expiration, database_fixture )
+{ try {
+   generate_block();
+
+   ACTORS((alice)(bob)(borrower)(borrower2)(feedproducer));
+   const auto& test = create_user_issued_asset("TEST");
+   const auto& bitusd = create_bitasset("BITUSD");
+   const auto& core = asset_id_type()(db);
+
+   transfer( committee_account, alice_id, asset(50000) );
+   transfer( committee_account, bob_id, asset(50000) );
+   issue_uia( bob, test.amount(50000) );
+
+   transfer( committee_account, borrower_id, asset(50000) );
+   transfer( committee_account, borrower2_id, asset(50000) );
+   update_feed_producers( bitusd, {feedproducer.id} );
+   price_feed current_feed;
+   current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+   publish_feed( bitusd, feedproducer, current_feed );
+   borrow( borrower, bitusd.amount(1000), asset(2000) );
+   borrow( borrower2, bitusd.amount(1000), asset(4000) );
+   const auto& calls_by_account = db.get_index_type<call_order_index>().indices().get<by_account>();
+   const call_order_id_type call_id = calls_by_account.find( boost::make_tuple( borrower_id, bitusd.id ) )->id;
+
+   auto expiration = db.head_block_time() + fc::seconds(10);
+   auto place = [&]( account_id_type seller, const asset& sell, const asset& receive )
+   {
+      limit_order_create_operation op;
+      op.seller = seller;
+      op.amount_to_sell = sell;
+      op.min_to_receive = receive;
+      op.expiration = expiration;
+      trx.operations.push_back(op);
+   };
+   for( int i = 0; i < 10; ++i )
+   {
+      place( alice_id, core.amount(100), test.amount(1000 + i) );
+      place( bob_id, core.amount(200), test.amount(2000 + i) );
+      place( bob_id, test.amount(300), core.amount(3000 + i) );
+   }
+   // the first is beyond borrower's call limit and stops check_call_orders at the top of the book; the second is
+   // inside the call range, below it
+   place( borrower2_id, bitusd.amount(100), core.amount(100) );
+   place( borrower2_id, bitusd.amount(500), core.amount(700) );
+   trx.set_expiration( db.head_block_time() + fc::minutes(1) );
+   PUSH_TX( db, trx, ~0 );
+   trx.operations.clear();
+   BOOST_CHECK_EQUAL( db.get_index_type<limit_order_index>().indices().size(), 32u );
+
+   BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), 49000 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 48000 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, test.id ), 47000 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).total_core_in_orders.value, 1000 );
+   BOOST_CHECK_EQUAL( bob_id(db).statistics(db).total_core_in_orders.value, 2000 );
+
+   int canceled = 0;
+   int filled_after_cancel = 0;
+   auto counter = db.applied_block.connect( [&]( const signed_block& ) {
+      const auto& ops = db.get_applied_operations();
+      for( size_t i = 0; i < ops.size(); ++i )
+         if( ops[i].op.which() == operation::tag<limit_order_cancel_operation>::value )
+         {
+            ++canceled;
+            // the fills of the call come right after the cancel which uncovered the order it fills against
+            for( size_t j = i + 1; j < ops.size() && ops[j].op.which() == operation::tag<fill_order_operation>::value; ++j )
+               ++filled_after_cancel;
+         }
+   });
+   generate_blocks( expiration, false );
+   counter.disconnect();
+
+   // the order inside the call range was filled, not canceled
+   BOOST_CHECK_EQUAL( canceled, 31 );
+   BOOST_CHECK_EQUAL( filled_after_cancel, 2 );
+   BOOST_CHECK_EQUAL( get_balance( borrower2_id, asset_id_type() ), 50000 - 4000 + 700 );
+   BOOST_CHECK_EQUAL( get_balance( borrower2_id, bitusd.id ), 1000 - 500 );
+   BOOST_CHECK_EQUAL( call_id(db).debt.value, 500 );
+   BOOST_CHECK( db.get_index_type<limit_order_index>().indices().empty() );
+   BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), 50000 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 50000 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, get_asset("TEST").id ), 50000 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).total_core_in_orders.value, 0 );
+   BOOST_CHECK_EQUAL( bob_id(db).statistics(db).total_core_in_orders.value, 0 );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE( double_sign_check, database_fixture )
 { try {
    generate_block();
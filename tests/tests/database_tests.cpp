@@ -21,8 +21,14 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/balance_object.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -53,3 +59,164 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_FIXTURE_TEST_CASE( bulk_genesis_accounts, database_fixture )
+{
+   try {
+      // the fixture's genesis state already holds the init accounts, which are lifetime members
+      auto shared_key = generate_private_key("shared").get_public_key();
+      auto active_key = generate_private_key("active").get_public_key();
+      genesis_state.initial_accounts.emplace_back("basic-a", shared_key);
+      genesis_state.initial_accounts.emplace_back("basic-b", shared_key, active_key);
+      genesis_state.initial_balances.push_back({shared_key, GRAPHENE_SYMBOL, 1});
+
+      // Intentionally overriding the fixture's db, to open one with this genesis state
+      database db;
+      fc::temp_directory td( graphene::utilities::temp_directory_path() );
+      db.open( td.path(), [this]{ return genesis_state; } );
+
+      const auto& accounts_by_name = db.get_index_type<account_index>().indices().get<by_name>();
+      const account_object& init0 = *accounts_by_name.find("init0");
+      BOOST_CHECK( init0.is_lifetime_member() );
+      BOOST_CHECK( init0.registrar == init0.id && init0.referrer == init0.id && init0.lifetime_referrer == init0.id );
+      BOOST_CHECK( init0.lifetime_referrer_fee_percentage == GRAPHENE_100_PERCENT - init0.network_fee_percentage );
+      BOOST_CHECK( init0.statistics(db).owner == init0.id );
+
+      const account_object& a = *accounts_by_name.find("basic-a");
+      const account_object& b = *accounts_by_name.find("basic-b");
+      BOOST_CHECK( a.is_basic_account( db.head_block_time() ) );
+      BOOST_CHECK( a.registrar == GRAPHENE_TEMP_ACCOUNT );
+      BOOST_CHECK( a.referrer == account_id_type() );
+      BOOST_CHECK( a.active == a.owner );
+      BOOST_CHECK( a.options.memo_key == shared_key );
+      BOOST_CHECK( b.active == authority( 1, active_key, 1 ) );
+      BOOST_CHECK( b.options.memo_key == active_key );
+      BOOST_CHECK( b.statistics(db).owner == b.id );
+      BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().accounts_registered_this_interval,
+                         genesis_state.initial_accounts.size() );
+      BOOST_CHECK_EQUAL( balance_id_type()(db).balance.amount.value, 1 );
+
+      // the member index is built in one pass at the end of the bulk load
+      const auto& members = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() )
+                               .get_secondary_index<account_member_index>();
+      BOOST_CHECK( members.get_key_references( shared_key ) == vector<account_id_type>({ a.get_id(), b.get_id() }) );
+      BOOST_CHECK_EQUAL( members.get_key_references( init_account_priv_key.get_public_key() ).size(),
+                         genesis_state.initial_active_witnesses );
+      BOOST_CHECK( members.get_key_references( active_key ).empty() );
+      auto batch = members.get_key_references( vector<public_key_type>({ active_key, shared_key }) );
+      BOOST_REQUIRE_EQUAL( batch.size(), 2u );
+      BOOST_CHECK( batch[0].empty() );
+      BOOST_CHECK( batch[1] == vector<account_id_type>({ a.get_id(), b.get_id() }) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( streamed_genesis, database_fixture )
+{
+   try {
+      auto shared_key = generate_private_key("shared").get_public_key();
+      for( int i = 0; i < 25; ++i )
+         genesis_state.initial_accounts.emplace_back( "streamed-" + std::to_string(i), shared_key, public_key_type(),
+                                                      i % 2 == 0 );
+      genesis_state_type::initial_asset_type streamed_asset;
+      streamed_asset.symbol = "STREAMED";
+      streamed_asset.precision = 4;
+      streamed_asset.issuer_name = "init0";
+      streamed_asset.max_supply = 1000000;
+      streamed_asset.market_fee_percent = 0;
+      streamed_asset.issuer_permissions = 0;
+      streamed_asset.flags = 0;
+      genesis_state.initial_assets.push_back( streamed_asset );
+      genesis_state.initial_balances.push_back({shared_key, GRAPHENE_SYMBOL, 5});
+      genesis_state.initial_balances.push_back({shared_key, "STREAMED", 7});
+      genesis_state_type::initial_vesting_balance_type vest;
+      vest.owner = shared_key;
+      vest.asset_symbol = GRAPHENE_SYMBOL;
+      vest.amount = 500;
+      vest.begin_balance = vest.amount;
+      vest.begin_timestamp = genesis_state.initial_timestamp;
+      vest.vesting_duration_seconds = 60;
+      genesis_state.initial_vesting_balances.push_back( vest );
+
+      fc::temp_directory td( graphene::utilities::temp_directory_path() );
+      fc::json::save_to_file( genesis_state, td.path() / "genesis.json" );
+
+      // batches smaller than the arrays, so the accounts are handed over in several of them
+      genesis_reader reader( td.path() / "genesis.json", 7 );
+      BOOST_CHECK_EQUAL( reader.account_count(), genesis_state.initial_accounts.size() );
+      BOOST_CHECK_EQUAL( reader.vesting_balance_count(), 1u );
+      BOOST_CHECK( reader.header().initial_accounts.empty() );
+      BOOST_CHECK_EQUAL( reader.header().initial_witness_candidates.size(),
+                         genesis_state.initial_witness_candidates.size() );
+
+      // Intentionally overriding the fixture's db, to compare a streamed genesis with one in memory
+      database streamed, in_memory;
+      streamed.open( td.path() / "streamed", [&reader]{ return reader; } );
+      in_memory.open( td.path() / "in_memory", [this]{ return genesis_state; } );
+
+      BOOST_CHECK( streamed.get_global_properties().chain_id == fc::digest( genesis_state ) );
+      auto packed = []( const database& db, uint8_t space, uint8_t type ) {
+         vector< vector<char> > result;
+         db.get_index( space, type ).inspect_all_objects( [&result]( const object& o ) {
+            result.push_back( o.pack() );
+         });
+         std::sort( result.begin(), result.end() );
+         return result;
+      };
+      auto check_same = [&]( uint8_t space, uint8_t type ) {
+         BOOST_CHECK( packed( streamed, space, type ) == packed( in_memory, space, type ) );
+      };
+      check_same( account_object::space_id, account_object::type_id );
+      check_same( account_statistics_object::space_id, account_statistics_object::type_id );
+      check_same( asset_object::space_id, asset_object::type_id );
+      check_same( asset_dynamic_data_object::space_id, asset_dynamic_data_object::type_id );
+      check_same( balance_object::space_id, balance_object::type_id );
+      check_same( global_property_object::space_id, global_property_object::type_id );
+      check_same( dynamic_global_property_object::space_id, dynamic_global_property_object::type_id );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( member_index_built_after_restart, database_fixture )
+{
+   try {
+      auto old_key = generate_private_key("old").get_public_key();
+      auto new_key = generate_private_key("new").get_public_key();
+      for( int i = 0; i < 100; ++i )
+         genesis_state.initial_accounts.emplace_back( "member-" + std::to_string(i), old_key );
+
+      fc::temp_directory td( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.open( td.path(), [this]{ return genesis_state; } );
+         db.close();
+      }
+
+      // reopening loads the accounts from disk, which builds the member index in the background
+      database db;
+      db.open( td.path(), [this]{ return genesis_state; } );
+      const auto& accounts_by_name = db.get_index_type<account_index>().indices().get<by_name>();
+      const account_object& changed = *accounts_by_name.find("member-0");
+      // a change made while the index may still be building must not be lost
+      db.modify( changed, [&]( account_object& a ) {
+         a.owner = authority( 1, new_key, 1 );
+      });
+
+      const auto& members = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() )
+                               .get_secondary_index<account_member_index>();
+      BOOST_CHECK_EQUAL( members.get_key_references( old_key ).size(), 99u );
+      BOOST_CHECK( members.get_key_references( new_key ) == vector<account_id_type>({ changed.get_id() }) );
+      BOOST_CHECK_EQUAL( members.get_key_references( init_account_priv_key.get_public_key() ).size(),
+                         genesis_state.initial_active_witnesses );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
@@ -24,11 +24,14 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/margin_call_trigger_index.hpp>
 #include <graphene/chain/market_evaluator.hpp>
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/witness_object.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -210,6 +213,271 @@ BOOST_AUTO_TEST_CASE( margin_call_limit_test )
    }
 }
 
+/**
+ *  A limit order which cannot trigger a margin call leaves the market idle in the margin call
+ *  trigger index; a later order inside the call range must still trigger the call.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_after_idle_market )
+{ try {
+      ACTORS((borrower)(borrower2)(feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+
+      int64_t init_balance(1000000);
+
+      transfer(committee_account, borrower_id, asset(init_balance));
+      transfer(committee_account, borrower2_id, asset(init_balance));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      borrow( borrower, bitusd.amount(1000), asset(2000));
+      borrow( borrower2, bitusd.amount(1000), asset(4000) );
+
+      // priced above the max short squeeze price, so no call may fill against it
+      auto resting = create_sell_order( borrower2, bitusd.amount(500), core.amount(1500) );
+      BOOST_REQUIRE( resting != nullptr );
+      limit_order_id_type resting_id = resting->id;
+
+      // inside the call range: fills against borrower's call order
+      auto order = create_sell_order( borrower2, bitusd.amount(500), core.amount(700) );
+      BOOST_REQUIRE( order == nullptr );
+      BOOST_CHECK_EQUAL( get_balance( borrower2, core ), init_balance - 4000 + 700 );
+      BOOST_CHECK( db.find( resting_id ) != nullptr );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  The order book used for matching must list each side of a market in the same sequence as the
+ *  by_price index, through fills, cancels and undo.
+ */
+BOOST_AUTO_TEST_CASE( order_book_index_mirrors_price_index )
+{ try {
+      ACTORS((seller)(buyer));
+
+      const auto& test = create_user_issued_asset("UIATEST");
+      const auto& core = asset_id_type()(db);
+      issue_uia( seller, test.amount(100000) );
+      transfer( committee_account, buyer_id, asset(100000) );
+
+      const auto& idx = dynamic_cast<const primary_index<limit_order_index>&>( db.get_index_type<limit_order_index>() );
+      const auto& book = idx.get_secondary_index<order_book_index>();
+      const auto& by_price_idx = idx.indices().get<by_price>();
+
+      auto check_book = [&]()
+      {
+         vector<object_id_type> from_book;
+         vector<object_id_type> from_index;
+         if( const auto* side = book.get_side( test.id, core.id ) )
+            for( auto level = side->rbegin(); level != side->rend(); ++level )
+               for( const limit_order_object* o : level->orders )
+                  from_book.push_back( o->id );
+         auto itr = by_price_idx.lower_bound( price::max( test.id, core.id ) );
+         auto end = by_price_idx.upper_bound( price::min( test.id, core.id ) );
+         for( ; itr != end; ++itr )
+            from_index.push_back( itr->id );
+         BOOST_CHECK( from_book == from_index );
+      };
+
+      // 2/4 and 1/2 are the same price and must share a level in arrival order
+      create_sell_order( seller, test.amount(100), core.amount(300) );
+      auto middle = create_sell_order( seller, test.amount(200), core.amount(400) )->id;
+      create_sell_order( seller, test.amount(100), core.amount(200) );
+      create_sell_order( seller, test.amount(100), core.amount(100) );
+      create_sell_order( seller, test.amount(300), core.amount(600) );
+      check_book();
+
+      // fills the 1/1 order and part of the oldest order at 1/2
+      BOOST_CHECK( create_sell_order( buyer, core.amount(300), test.amount(150) ) == nullptr );
+      check_book();
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         cancel_limit_order( middle(db) );
+         check_book();
+         BOOST_CHECK( create_sell_order( buyer, core.amount(1000), test.amount(10) ) == nullptr );
+         check_book();
+      }
+      // the undo session restores every removed order
+      BOOST_CHECK( db.find( middle ) != nullptr );
+      check_book();
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  An order priced beyond the call limit at the top of the book keeps a callable order below it from filling the
+ *  call.  Canceling the top order must uncover the one below, even though the market was left idle.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_after_top_order_canceled )
+{ try {
+      ACTORS((borrower)(borrower2)(feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+
+      int64_t init_balance(1000000);
+
+      transfer(committee_account, borrower_id, asset(init_balance));
+      transfer(committee_account, borrower2_id, asset(init_balance));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      borrow( borrower, bitusd.amount(1000), asset(2000));
+      borrow( borrower2, bitusd.amount(1000), asset(4000) );
+
+      // beyond borrower's call limit, so it stops check_call_orders at the top of the book
+      auto top = create_sell_order( borrower2, bitusd.amount(100), core.amount(100) );
+      BOOST_REQUIRE( top != nullptr );
+      // inside the call range, but below the top of the book
+      auto below = create_sell_order( borrower2, bitusd.amount(500), core.amount(700) );
+      BOOST_REQUIRE( below != nullptr );
+      limit_order_id_type below_id = below->id;
+
+      cancel_limit_order( *top );
+      BOOST_CHECK( db.find( below_id ) == nullptr );
+      BOOST_CHECK_EQUAL( get_balance( borrower2, core ), init_balance - 4000 + 700 );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  A margin call which fills a limit order and then only part of the next one passes over the rest of that order, as
+ *  check_call_orders always has.  The market must not be marked idle then: the remaining call order matches the rest
+ *  of the order and has to be executed by the next check.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_after_partly_filled_order )
+{ try {
+      ACTORS((borrower)(borrower2)(borrower3)(feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+
+      int64_t init_balance(1000000);
+
+      transfer(committee_account, borrower_id, asset(init_balance));
+      transfer(committee_account, borrower2_id, asset(init_balance));
+      transfer(committee_account, borrower3_id, asset(init_balance));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      // borrower and borrower3 share a call limit of 0.875 USD per CORE
+      const call_order_object* first = borrow( borrower, bitusd.amount(1000), asset(2000) );
+      const call_order_object* second = borrow( borrower3, bitusd.amount(1000), asset(2000) );
+      BOOST_REQUIRE( first != nullptr && second != nullptr );
+      call_order_id_type first_id = first->id;
+      call_order_id_type second_id = second->id;
+      borrow( borrower2, bitusd.amount(2000), asset(8000) );
+
+      // both inside the call limit but below the squeeze price of this feed, so nothing is called yet
+      BOOST_REQUIRE( create_sell_order( borrower2, bitusd.amount(500), core.amount(790) ) != nullptr );
+      auto partly = create_sell_order( borrower2, bitusd.amount(1500), core.amount(2400) );
+      BOOST_REQUIRE( partly != nullptr );
+      limit_order_id_type partly_id = partly->id;
+
+      // the lower feed makes both orders eligible: the first call takes all of the first order and part of the
+      // second one, after which the check passes over the rest of the second order
+      current_feed.settlement_price = bitusd.amount( 50 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+      BOOST_CHECK( db.find( first_id ) == nullptr );
+      BOOST_REQUIRE( db.find( second_id ) != nullptr );
+      BOOST_REQUIRE( db.find( partly_id ) != nullptr );
+      BOOST_CHECK_EQUAL( partly_id(db).for_sale.value, 1000 );
+
+      // the next check fills the second call against the rest of the order
+      generate_block();
+      BOOST_CHECK( db.find( first_id ) == nullptr );
+      BOOST_CHECK( db.find( second_id ) == nullptr );
+      BOOST_CHECK( db.find( partly_id ) == nullptr );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Saves the state while a market is idle in the margin call trigger index and reopens it.  The reopened database
+ *  must not trust the idle market before a full check, and the same order must trigger the same margin call in both.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_triggers_after_reopen )
+{ try {
+      ACTORS((borrower)(borrower2)(feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+      const asset_id_type bitusd_id = bitusd.id;
+
+      int64_t init_balance(1000000);
+
+      transfer(committee_account, borrower_id, asset(init_balance));
+      transfer(committee_account, borrower2_id, asset(init_balance));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      borrow( borrower, bitusd.amount(1000), asset(2000));
+      borrow( borrower2, bitusd.amount(1000), asset(4000) );
+      BOOST_REQUIRE( create_sell_order( borrower2, bitusd.amount(500), core.amount(1500) ) != nullptr );
+
+      auto triggers = []( const database& d ) -> const margin_call_trigger_index& {
+         return dynamic_cast<const primary_index<limit_order_index>&>( d.get_index_type<limit_order_index>() )
+                   .get_secondary_index<margin_call_trigger_index>();
+      };
+      BOOST_CHECK( !triggers( db ).might_call( bitusd_id ) );
+
+      fc::temp_directory reopened_dir( graphene::utilities::temp_directory_path() );
+      db.save( reopened_dir.path() );
+      database reopened;
+      reopened.open( reopened_dir.path(), [this]{ return genesis_state; } );
+      BOOST_CHECK( triggers( reopened ).might_call( bitusd_id ) );
+
+      // inside the call range: fills against borrower's call order in both databases
+      for( database* d : { &db, &reopened } )
+      {
+         signed_transaction t;
+         t.set_expiration( d->head_block_time() + fc::minutes(1) );
+         limit_order_create_operation op;
+         op.seller = borrower2_id;
+         op.amount_to_sell = asset( 500, bitusd_id );
+         op.min_to_receive = asset( 700 );
+         t.operations.push_back( op );
+         d->push_transaction( t, ~0 );
+         BOOST_CHECK_EQUAL( d->get_balance( borrower2_id, asset_id_type() ).amount.value, init_balance - 4000 + 700 );
+      }
+      const auto& calls = db.get_index_type<call_order_index>().indices();
+      BOOST_REQUIRE_EQUAL( calls.size(), reopened.get_index_type<call_order_index>().indices().size() );
+      for( const call_order_object& call : calls )
+      {
+         const call_order_object* reopened_call = reopened.find<call_order_object>( call.id );
+         BOOST_REQUIRE( reopened_call != nullptr );
+         BOOST_CHECK( call.debt == reopened_call->debt );
+         BOOST_CHECK( call.collateral == reopened_call->collateral );
+      }
+      BOOST_CHECK( triggers( db ).might_call( bitusd_id ) == triggers( reopened ).might_call( bitusd_id ) );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 /**
  *  This test sets up the minimum condition for a black swan to occur but does
  *  not test the full range of cases that may be possible during a black swan.
@@ -1070,6 +1338,114 @@ BOOST_AUTO_TEST_CASE( trade_amount_equals_zero )
 }
 
 
+/**
+ *  A feed must be dropped from the median once it is older than feed_lifetime_sec, and the asset's core exchange
+ *  rate must follow the median feed at the end of the block.  Once GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME has passed
+ *  this holds even when no block is produced at the exact expiration time.
+ */
+BOOST_AUTO_TEST_CASE( feed_expiration )
+{ try {
+      generate_blocks( GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME );
+      ACTORS((feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+      update_feed_producers( bitusd, {feedproducer.id} );
+      generate_block();
+
+      // modified outside of any transaction so that it is not undone with the pending ones
+      const asset_object& mia = get_asset("BITUSD");
+      db.modify( mia.bitasset_data(db), []( asset_bitasset_data_object& b ) {
+         b.options.feed_lifetime_sec = 60;
+      });
+      BOOST_CHECK( mia.bitasset_data(db).asset_id == mia.id );
+
+      price_feed current_feed;
+      current_feed.settlement_price = mia.amount( 100 ) / core.amount( 100 );
+      current_feed.core_exchange_rate = mia.amount( 1 ) / core.amount( 3 );
+      publish_feed( mia, feedproducer, current_feed );
+      BOOST_CHECK( !mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+
+      generate_block();
+      BOOST_CHECK( get_asset("BITUSD").options.core_exchange_rate == current_feed.core_exchange_rate );
+
+      generate_blocks( db.head_block_time() + fc::seconds(30) );
+      BOOST_CHECK( !get_asset("BITUSD").bitasset_data(db).current_feed.settlement_price.is_null() );
+
+      generate_blocks( db.head_block_time() + fc::seconds(60) );
+      BOOST_CHECK( get_asset("BITUSD").bitasset_data(db).current_feed.settlement_price.is_null() );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+/**
+ *  Before GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME feeds must expire exactly as they always have: medians below the
+ *  minimum number of feeds are recalculated in every block, and a feed is only dropped by a block produced at its
+ *  exact expiration time.
+ */
+BOOST_AUTO_TEST_CASE( feed_expiration_before_hardfork )
+{ try {
+      ACTORS((feedproducer));
+
+      const auto& bitusd = create_bitasset("BITUSD");
+      const auto& core   = asset_id_type()(db);
+      update_feed_producers( bitusd, {feedproducer.id} );
+      generate_block();
+      BOOST_REQUIRE( db.head_block_time() < GRAPHENE_FEED_EXPIRATION_HARDFORK_TIME );
+
+      // modified outside of any transaction so that it is not undone with the pending ones
+      const asset_object& mia = get_asset("BITUSD");
+      db.modify( mia.bitasset_data(db), []( asset_bitasset_data_object& b ) {
+         b.options.feed_lifetime_sec = 60;
+         b.options.minimum_feeds = 2;
+      });
+
+      price_feed current_feed;
+      current_feed.settlement_price = mia.amount( 100 ) / core.amount( 100 );
+      current_feed.core_exchange_rate = mia.amount( 1 ) / core.amount( 3 );
+      publish_feed( mia, feedproducer, current_feed );
+
+      // too few feeds: the publication time follows the head block
+      for( int i = 0; i < 3; ++i )
+      {
+         generate_block();
+         BOOST_CHECK( mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+         BOOST_CHECK( mia.bitasset_data(db).current_feed_publication_time == db.head_block_time() );
+      }
+
+      db.modify( mia.bitasset_data(db), []( asset_bitasset_data_object& b ) {
+         b.options.minimum_feeds = 1;
+      });
+      publish_feed( mia, feedproducer, current_feed );
+      const time_point_sec published = db.head_block_time();
+
+      generate_block();
+      BOOST_CHECK( !mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+      BOOST_CHECK( mia.bitasset_data(db).current_feed_publication_time == published );
+      BOOST_CHECK( get_asset("BITUSD").options.core_exchange_rate == current_feed.core_exchange_rate );
+
+      // no block at published + 60, so the stale feed stays in the median
+      generate_blocks( published + fc::seconds(65) );
+      BOOST_REQUIRE( db.head_block_time() > published + fc::seconds(60) );
+      BOOST_CHECK( !mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+      BOOST_CHECK( mia.bitasset_data(db).current_feed_publication_time == published );
+
+      // a feed whose expiration block is produced is dropped in that block
+      publish_feed( mia, feedproducer, current_feed );
+      const time_point_sec republished = db.head_block_time();
+      generate_blocks( republished + fc::seconds(55) );
+      BOOST_CHECK( !mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+      generate_blocks( republished + fc::seconds(60), false );
+      BOOST_REQUIRE( db.head_block_time() == republished + fc::seconds(60) );
+      BOOST_CHECK( mia.bitasset_data(db).current_feed.settlement_price.is_null() );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 /**
  *  Create an order that cannot be filled immediately and have the
  *  transaction fail.
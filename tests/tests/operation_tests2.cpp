@@ -944,6 +944,75 @@ BOOST_AUTO_TEST_CASE( unimp_force_settlement_unavailable )
     */
 }
 
+/**
+ *  Many force settlements reaching their settlement date in the same block: they must be executed oldest first
+ *  against the least collateralized positions, up to the maximum force settlement volume.
+ */
+BOOST_AUTO_TEST_CASE( simultaneous_force_settlements )
+{ try {
+   ACTOR(feedproducer);
+   const auto& bitusd = create_bitasset("BITUSD");
+   const asset_id_type bitusd_id = bitusd.id;
+   const auto& core = asset_id_type()(db);
+   update_feed_producers( bitusd, {feedproducer.id} );
+
+   price_feed current_feed;
+   current_feed.settlement_price = bitusd.amount( 100 ) / core.amount( 100 );
+   publish_feed( bitusd, feedproducer, current_feed );
+
+   const int borrower_count = 5;
+   const int holder_count = 50;
+   const int orders_per_holder = 20;
+   const int order_size = 400;
+
+   vector<account_id_type> borrowers;
+   for( int i = 0; i < borrower_count; ++i )
+   {
+      borrowers.push_back( create_account( "borrower" + fc::to_string(i) ).id );
+      transfer( committee_account, borrowers.back(), asset(1000000) );
+      // the first borrower is the least collateralized
+      borrow( borrowers.back(), asset(100000, bitusd_id), asset(200000 + 50000 * i) );
+   }
+   vector<account_id_type> holders;
+   for( int i = 0; i < holder_count; ++i )
+   {
+      holders.push_back( create_account( "holder" + fc::to_string(i) ).id );
+      transfer( borrowers[i % borrower_count], holders.back(), asset(orders_per_holder * order_size, bitusd_id) );
+   }
+   generate_block();
+
+   const share_type supply_before = bitusd_id(db).dynamic_data(db).current_supply;
+   for( auto holder : holders )
+      for( int i = 0; i < orders_per_holder; ++i )
+         force_settle( holder, asset(order_size, bitusd_id) );
+
+   const auto& settlements = db.get_index_type<force_settlement_index>().indices();
+   BOOST_REQUIRE_EQUAL( settlements.size(), holder_count * orders_per_holder );
+   auto settlement_date = settlements.begin()->settlement_date;
+   generate_blocks( settlement_date );
+
+   // 20% of the supply, which is exactly the debt of the least collateralized borrower
+   const share_type max_volume = supply_before.value / 5;
+   const int orders_settled = max_volume.value / order_size;
+   BOOST_CHECK_EQUAL( bitusd_id(db).dynamic_data(db).current_supply.value, (supply_before - max_volume).value );
+   BOOST_CHECK_EQUAL( settlements.size(), holder_count * orders_per_holder - orders_settled );
+   share_type unsettled;
+   for( const force_settlement_object& s : settlements )
+      unsettled += s.balance.amount;
+   BOOST_CHECK_EQUAL( unsettled.value, holder_count * orders_per_holder * order_size - max_volume.value );
+
+   BOOST_CHECK_EQUAL( db.get_index_type<call_order_index>().indices().size(), borrower_count - 1 );
+   BOOST_CHECK_EQUAL( get_balance( borrowers[0], asset_id_type() ), 1000000 - 100000 );
+
+   // settlements are filled in the order they were requested, at the feed price
+   for( int i = 0; i < holder_count; ++i )
+   {
+      int filled = std::max( 0, std::min( orders_per_holder, orders_settled - i * orders_per_holder ) );
+      BOOST_CHECK_EQUAL( get_balance( holders[i], asset_id_type() ), filled * order_size );
+   }
+   verify_asset_supplies(db);
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( assert_op_test )
 {
    try {